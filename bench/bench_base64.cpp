@@ -0,0 +1,117 @@
+// Throughput of the base64 decoders on the images embedded in a notebook.
+// Build with the bench_base64 target and run it from the repository root,
+// or pass the notebook to read: bench_base64 [path/to/notebook.ipynb]
+
+#include "base64.h"
+#include "json.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+
+struct Input {
+    std::string name;
+    std::vector<std::string> payloads;
+    size_t bytes;
+};
+
+// Every PNG and JPEG payload of the notebook's outputs
+std::vector<std::string> loadImages(const char* path) {
+    std::ifstream file(path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+
+    std::vector<std::string> images;
+    json notebook = json::parse(buffer.str(), nullptr, false);
+    if (notebook.is_discarded() || !notebook.contains("cells")) return images;
+
+    for (const auto& cell : notebook["cells"]) {
+        if (!cell.contains("outputs")) continue;
+        for (const auto& output : cell["outputs"]) {
+            if (!output.contains("data")) continue;
+            for (const char* mimeType : {"image/png", "image/jpeg"}) {
+                if (output["data"].contains(mimeType) && output["data"][mimeType].is_string()) {
+                    images.push_back(output["data"][mimeType].get<std::string>());
+                }
+            }
+        }
+    }
+    return images;
+}
+
+// Same payloads with a newline every 76 characters (MIME style), which
+// takes the whitespace path at the end of every line
+std::vector<std::string> wrapLines(const std::vector<std::string>& payloads) {
+    std::vector<std::string> wrapped;
+    for (const auto& payload : payloads) {
+        std::string text;
+        for (size_t pos = 0; pos < payload.length(); pos += 76) {
+            text.append(payload, pos, 76);
+            text += '\n';
+        }
+        wrapped.push_back(text);
+    }
+    return wrapped;
+}
+
+Input makeInput(const std::string& name, std::vector<std::string> payloads) {
+    size_t bytes = 0;
+    for (const auto& payload : payloads) {
+        bytes += payload.length();
+    }
+    return {name, std::move(payloads), bytes};
+}
+
+double measure(const Input& input) {
+    const size_t targetBytes = 256 * 1024 * 1024;
+    size_t rounds = targetBytes / input.bytes + 1;
+
+    std::string out;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; i++) {
+        for (const auto& payload : input.payloads) {
+            out.clear();
+            if (!base64Decode(payload, out)) {
+                fprintf(stderr, "invalid payload in %s\n", input.name.c_str());
+                return 0;
+            }
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return (input.bytes * rounds) / seconds / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "content/blog/02_production.ipynb";
+    std::vector<std::string> images = loadImages(path);
+    if (images.empty()) {
+        fprintf(stderr, "no images found in %s\n", path);
+        return 1;
+    }
+
+    std::vector<Input> inputs;
+    inputs.push_back(makeInput("notebook images", images));
+    inputs.push_back(makeInput("wrapped at 76", wrapLines(images)));
+
+    printf("%zu images, %zu KB of base64\n", images.size(), inputs[0].bytes / 1024);
+    printf("%-20s %-8s %12s\n", "input", "decoder", "MB/s");
+    const char* implementations[] = {"scalar", "ssse3", "avx2"};
+    for (const auto& input : inputs) {
+        for (const char* name : implementations) {
+            if (!selectBase64Implementation(name)) continue;
+            printf("%-20s %-8s %12.0f\n", input.name.c_str(), name, measure(input));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Throughput of the HTML/JSON escaping scanners on notebook-sized inputs.
+// Build with the bench_escape target and run it without arguments.
+
+#include "escape.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Input {
+    const char* name;
+    std::string text;
+};
+
+std::string repeatTo(const std::string& unit, size_t size) {
+    std::string text;
+    text.reserve(size + unit.length());
+    while (text.length() < size) {
+        text += unit;
+    }
+    text.resize(size);
+    return text;
+}
+
+// A code cell, a long text output, a traceback with ANSI colour codes and an
+// HTML table output, each at a size typical of real notebooks
+std::vector<Input> buildInputs() {
+    const std::string code =
+        "def train(model, loader, epochs=10):\n"
+        "    for epoch in range(epochs):\n"
+        "        loss = model.step(loader)\n"
+        "        if loss < best and epoch > 2:\n"
+        "            print(f\"epoch {epoch}: loss={loss:.4f}\")\n";
+    const std::string prose =
+        "The quick brown fox jumps over the lazy dog while the model converges "
+        "slowly towards a plateau that nobody expected to reach this early on. ";
+    const std::string traceback =
+        "\x1b[0;31mValueError\x1b[0m                                Traceback\n"
+        "\x1b[0;32m----> 1\x1b[0m model.fit(X, y)\t# \"shape\" mismatch\n";
+    const std::string table =
+        "<tr><td>0.125</td><td>&nbsp;</td><td class=\"num\">'a' & 'b'</td></tr>\n";
+
+    return {
+        {"code cell 4KB", repeatTo(code, 4 * 1024)},
+        {"text output 256KB", repeatTo(prose, 256 * 1024)},
+        {"traceback 64KB", repeatTo(traceback, 64 * 1024)},
+        {"html output 1MB", repeatTo(table, 1024 * 1024)},
+    };
+}
+
+template <typename Escape>
+double measure(const std::string& text, Escape escape) {
+    const size_t targetBytes = 256 * 1024 * 1024;
+    size_t rounds = targetBytes / text.length() + 1;
+
+    std::string out;
+    out.reserve(text.length() * 2);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; i++) {
+        out.clear();
+        escape(text, out);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return (text.length() * rounds) / seconds / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+int main() {
+    std::vector<Input> inputs = buildInputs();
+    const char* implementations[] = {"scalar", "sse2", "avx2"};
+
+    printf("%-20s %-8s %12s %12s\n", "input", "scanner", "html MB/s", "json MB/s");
+    for (const auto& input : inputs) {
+        for (const char* name : implementations) {
+            if (!selectEscapeImplementation(name)) continue;
+
+            double html = measure(input.text, [](const std::string& s, std::string& out) {
+                escapeHTML(s, out);
+            });
+            double json = measure(input.text, [](const std::string& s, std::string& out) {
+                escapeJSON(s, out);
+            });
+            printf("%-20s %-8s %12.0f %12.0f\n", input.name, name, html, json);
+        }
+    }
+
+    return 0;
+}
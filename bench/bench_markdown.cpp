@@ -0,0 +1,466 @@
+// Throughput of the markdown parser on deterministic synthetic corpora, plus
+// adversarial single-line inputs that must stay above a MB/s floor.
+// Build with the bench_markdown target.
+//
+//   bench_markdown [--json] [--size <MB>] [--repeat <n>] [--floor <MB/s>] [--parallel]
+//
+// --json prints one JSON object that can be diffed between commits.
+// The exit status is 1 if any stress case falls below the floor.
+
+#include "markdown_parser.h"
+#include "toc.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+// Every heap allocation in the process is counted
+namespace {
+std::atomic<size_t> allocationCount(0);
+}
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// std::pmr::new_delete_resource allocates through the aligned forms
+void* operator new(size_t size, std::align_val_t alignment) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+    void* p = std::aligned_alloc(align, (size + align - 1) / align * align);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+// Fixed-seed generator so every run and every commit sees the same corpus
+class CorpusRandom {
+public:
+    explicit CorpusRandom(uint64_t seed) : state(seed) {}
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return static_cast<uint32_t>(state >> 11);
+    }
+
+    size_t below(size_t n) {
+        return next() % n;
+    }
+
+private:
+    uint64_t state;
+};
+
+const char* const WORDS[] = {
+    "the", "system", "latency", "of", "a", "request", "depends", "on", "queue", "depth",
+    "and", "replication", "lag", "while", "throughput", "scales", "with", "partitions", "in",
+    "practice", "most", "workloads", "are", "read", "heavy", "so", "caching", "helps",
+    "consistency", "models", "trade", "availability", "for", "correctness", "under", "failure",
+};
+const size_t WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+
+void appendWords(CorpusRandom& random, size_t count, std::string& out) {
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) out += ' ';
+        out += WORDS[random.below(WORD_COUNT)];
+    }
+}
+
+// Inline span: a plain word or one wrapped in the markup a style favours
+void appendStyledWord(CorpusRandom& random, int style, std::string& out) {
+    const char* word = WORDS[random.below(WORD_COUNT)];
+    size_t roll = random.below(10);
+
+    if (style == 1 && roll < 6) {
+        const char* marks[] = {"*", "**", "_", "__", "`"};
+        const char* mark = marks[random.below(5)];
+        out += mark;
+        out += word;
+        out += mark;
+    } else if (style == 2 && roll < 4) {
+        if (random.below(4) == 0) {
+            out += "![";
+            out += word;
+            out += "](images/";
+            out += word;
+            out += ".png)";
+        } else {
+            out += '[';
+            out += word;
+            out += "](https://example.com/";
+            out += word;
+            out += ')';
+        }
+    } else {
+        out += word;
+    }
+}
+
+void appendParagraph(CorpusRandom& random, int style, std::string& out) {
+    size_t lines = 1 + random.below(4);
+    for (size_t line = 0; line < lines; line++) {
+        size_t words = 8 + random.below(10);
+        for (size_t i = 0; i < words; i++) {
+            if (i > 0) out += ' ';
+            appendStyledWord(random, style, out);
+        }
+        out += '\n';
+    }
+    out += '\n';
+}
+
+void appendHeading(CorpusRandom& random, std::string& out) {
+    out.append(2 + random.below(3), '#');
+    out += ' ';
+    appendWords(random, 2 + random.below(4), out);
+    out += "\n\n";
+}
+
+void appendTable(CorpusRandom& random, std::string& out) {
+    size_t columns = 3 + random.below(4);
+    size_t rows = 20 + random.below(40);
+    const char* delimiters[] = {"---", ":---", "---:", ":---:"};
+
+    for (size_t c = 0; c < columns; c++) {
+        out += "| ";
+        appendWords(random, 1, out);
+        out += ' ';
+    }
+    out += "|\n";
+    for (size_t c = 0; c < columns; c++) {
+        out += '|';
+        out += delimiters[random.below(4)];
+    }
+    out += "|\n";
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t c = 0; c < columns; c++) {
+            out += "| ";
+            appendStyledWord(random, 1, out);
+            out += ' ';
+        }
+        out += "|\n";
+    }
+    out += '\n';
+}
+
+void appendCodeFence(CorpusRandom& random, std::string& out) {
+    const char* languages[] = {"python", "cpp", "bash", "json", ""};
+    const char* lines[] = {
+        "for item in items:",
+        "    total += item.value * 2  # accumulate",
+        "if (count > 0 && ptr != nullptr) { return \"ok\"; }",
+        "std::vector<int> values = {1, 2, 3};",
+        "echo \"$HOME\" | grep -v '^#' > out.txt",
+        "{\"name\": \"node\", \"replicas\": 3, \"ready\": true}",
+    };
+
+    out += "```";
+    out += languages[random.below(5)];
+    out += '\n';
+    size_t count = 4 + random.below(16);
+    for (size_t i = 0; i < count; i++) {
+        out += lines[random.below(6)];
+        out += '\n';
+    }
+    out += "```\n\n";
+}
+
+void appendList(CorpusRandom& random, std::string& out) {
+    bool ordered = random.below(2) == 0;
+    size_t items = 3 + random.below(12);
+    for (size_t i = 0; i < items; i++) {
+        if (ordered) {
+            out += std::to_string(i + 1);
+            out += ". ";
+        } else {
+            out += random.below(2) ? "- " : "* ";
+        }
+        size_t words = 3 + random.below(10);
+        for (size_t w = 0; w < words; w++) {
+            if (w > 0) out += ' ';
+            appendStyledWord(random, 1, out);
+        }
+        out += '\n';
+    }
+    out += '\n';
+}
+
+enum CorpusKind {
+    CORPUS_PROSE,
+    CORPUS_EMPHASIS,
+    CORPUS_LINKS,
+    CORPUS_TABLES,
+    CORPUS_CODE,
+    CORPUS_LISTS
+};
+
+// A document of about size bytes in which the given kind of block dominates
+std::string generateCorpus(CorpusKind kind, size_t size) {
+    CorpusRandom random(0x9e3779b97f4a7c15ULL + kind);
+    std::string doc = "# Synthetic benchmark corpus\n\n";
+
+    while (doc.size() < size) {
+        if (random.below(12) == 0) {
+            appendHeading(random, doc);
+        }
+        switch (kind) {
+            case CORPUS_PROSE:
+                appendParagraph(random, 0, doc);
+                break;
+            case CORPUS_EMPHASIS:
+                appendParagraph(random, 1, doc);
+                break;
+            case CORPUS_LINKS:
+                appendParagraph(random, 2, doc);
+                break;
+            case CORPUS_TABLES:
+                appendTable(random, doc);
+                appendParagraph(random, 0, doc);
+                break;
+            case CORPUS_CODE:
+                appendCodeFence(random, doc);
+                appendParagraph(random, 0, doc);
+                break;
+            case CORPUS_LISTS:
+                appendList(random, doc);
+                break;
+        }
+    }
+    return doc;
+}
+
+struct Measurement {
+    double seconds;
+    size_t allocations;
+};
+
+// Best of repeat runs; allocations are from the last run
+Measurement measure(int repeat, const std::function<void()>& operation) {
+    Measurement best{1e30, 0};
+    for (int i = 0; i < repeat; i++) {
+        size_t allocationsBefore = allocationCount.load();
+        auto start = std::chrono::steady_clock::now();
+        operation();
+        auto end = std::chrono::steady_clock::now();
+
+        best.seconds = std::min(best.seconds, std::chrono::duration<double>(end - start).count());
+        best.allocations = allocationCount.load() - allocationsBefore;
+    }
+    return best;
+}
+
+struct Result {
+    std::string corpus;
+    std::string operation;
+    size_t bytes;
+    size_t lines;
+    Measurement measurement;
+
+    double megabytesPerSecond() const {
+        return bytes / measurement.seconds / (1024.0 * 1024.0);
+    }
+    double nanosecondsPerLine() const {
+        return measurement.seconds * 1e9 / lines;
+    }
+    double allocationsPerKilobyte() const {
+        return measurement.allocations / (bytes / 1024.0);
+    }
+};
+
+struct StressResult {
+    std::string name;
+    size_t bytes;
+    double megabytesPerSecond;
+    bool passed;
+};
+
+std::string repeatTo(const std::string& unit, size_t size) {
+    std::string text;
+    while (text.size() < size) {
+        text += unit;
+    }
+    return text;
+}
+
+// Single 1 MB lines that used to make the inline renderer quadratic
+std::vector<std::pair<std::string, std::string>> stressCases() {
+    const size_t size = 1 << 20;
+    return {
+        {"unmatched-stars", repeatTo("*a", size)},
+        {"unmatched-underscores", repeatTo("_ ", size)},
+        {"mixed-delimiters", repeatTo("*_**__ ", size)},
+        {"open-brackets", repeatTo("[", size)},
+        {"nested-brackets", std::string(size / 2, '[') + std::string(size / 2, ']')},
+        {"open-images", repeatTo("![", size)},
+        {"image-chain", repeatTo("[![a](b)", size) + "]x"},
+        {"labels-without-urls", repeatTo("[a]", size)},
+        {"unclosed-urls", repeatTo("[a](", size)},
+        {"backticks", repeatTo("`", size)},
+    };
+}
+
+void printText(const std::vector<Result>& results, const std::vector<StressResult>& stress, double floor) {
+    printf("%-10s %-15s %10s %12s %12s\n", "corpus", "operation", "MB/s", "ns/line", "allocs/KB");
+    for (const auto& result : results) {
+        printf("%-10s %-15s %10.1f %12.1f %12.3f\n", result.corpus.c_str(), result.operation.c_str(),
+               result.megabytesPerSecond(), result.nanosecondsPerLine(), result.allocationsPerKilobyte());
+    }
+
+    printf("\nstress (floor %.1f MB/s)\n", floor);
+    for (const auto& result : stress) {
+        printf("%-22s %10.1f MB/s  %s\n", result.name.c_str(), result.megabytesPerSecond,
+               result.passed ? "ok" : "BELOW FLOOR");
+    }
+}
+
+void printJSON(const std::vector<Result>& results, const std::vector<StressResult>& stress, double floor) {
+    printf("{\n  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        printf("    {\"corpus\": \"%s\", \"operation\": \"%s\", \"bytes\": %zu, \"lines\": %zu, "
+               "\"mb_per_s\": %.2f, \"ns_per_line\": %.2f, \"allocs_per_kb\": %.4f}%s\n",
+               result.corpus.c_str(), result.operation.c_str(), result.bytes, result.lines,
+               result.megabytesPerSecond(), result.nanosecondsPerLine(), result.allocationsPerKilobyte(),
+               i + 1 < results.size() ? "," : "");
+    }
+    printf("  ],\n  \"stress_floor_mb_per_s\": %.2f,\n  \"stress\": [\n", floor);
+    for (size_t i = 0; i < stress.size(); i++) {
+        const StressResult& result = stress[i];
+        printf("    {\"name\": \"%s\", \"bytes\": %zu, \"mb_per_s\": %.2f, \"passed\": %s}%s\n",
+               result.name.c_str(), result.bytes, result.megabytesPerSecond,
+               result.passed ? "true" : "false", i + 1 < stress.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    bool json = false;
+    bool parallel = false;
+    size_t corpusSize = 4 << 20;
+    int repeat = 5;
+    // A quadratic scan of a 1 MB line runs far below this; linear ones
+    // run at tens of MB/s even in unoptimized builds
+    double floor = 2.0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--json") {
+            json = true;
+        } else if (arg == "--parallel") {
+            parallel = true;
+        } else if (arg == "--size" && i + 1 < argc) {
+            corpusSize = static_cast<size_t>(std::max(1.0, std::atof(argv[++i]) * 1024 * 1024));
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--floor" && i + 1 < argc) {
+            floor = std::atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--json] [--size <MB>] [--repeat <n>] [--floor <MB/s>] [--parallel]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+#ifndef __OPTIMIZE__
+    fprintf(stderr, "warning: bench_markdown was built without optimization\n");
+#endif
+
+    const std::pair<CorpusKind, const char*> corpora[] = {
+        {CORPUS_PROSE, "prose"},
+        {CORPUS_EMPHASIS, "emphasis"},
+        {CORPUS_LINKS, "links"},
+        {CORPUS_TABLES, "tables"},
+        {CORPUS_CODE, "code"},
+        {CORPUS_LISTS, "lists"},
+    };
+
+    MarkdownParser parser;
+    if (!parallel) {
+        // Single-threaded numbers compare across machines and commits
+        parser.setParallelThreshold(SIZE_MAX);
+    }
+
+    std::vector<Result> results;
+    std::string html;
+    for (const auto& corpus : corpora) {
+        std::string markdown = generateCorpus(corpus.first, corpusSize);
+        size_t lines = std::count(markdown.begin(), markdown.end(), '\n') + 1;
+        html.reserve(markdown.size() * 3);
+
+        // Warm up scratch buffers and the arena
+        html.clear();
+        parser.convertToHTML(markdown, html);
+        MarkdownDocument doc = parser.parseDocument(markdown);
+
+        auto add = [&](const char* operation, const std::function<void()>& run) {
+            results.push_back({corpus.second, operation, markdown.size(), lines, measure(repeat, run)});
+        };
+
+        add("convertToHTML", [&] {
+            html.clear();
+            parser.convertToHTML(markdown, html);
+        });
+        // Title and excerpt are extracted by the same single parse
+        add("parseDocument", [&] {
+            MarkdownDocument parsed = parser.parseDocument(markdown);
+        });
+        add("renderHTML", [&] {
+            html.clear();
+            parser.renderHTML(doc, html);
+        });
+        add("generateTOC", [&] {
+            std::string toc = generateTOC(doc);
+        });
+    }
+
+    std::vector<StressResult> stress;
+    bool passed = true;
+    for (const auto& stressCase : stressCases()) {
+        Measurement measurement = measure(1, [&] {
+            html.clear();
+            parser.convertToHTML(stressCase.second, html);
+        });
+        double megabytesPerSecond = stressCase.second.size() / measurement.seconds / (1024.0 * 1024.0);
+        bool ok = megabytesPerSecond >= floor;
+        passed = passed && ok;
+        stress.push_back({stressCase.first, stressCase.second.size(), megabytesPerSecond, ok});
+    }
+
+    if (json) {
+        printJSON(results, stress, floor);
+    } else {
+        printText(results, stress, floor);
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for the temporaries of one render. Deallocation is a no-op;
+// reset() releases everything at once and keeps the memory for the next
+// document, so rendering document after document stops touching the heap.
+class RenderArena : public std::pmr::memory_resource {
+public:
+    explicit RenderArena(size_t initialSize = 16 * 1024);
+
+    RenderArena(const RenderArena&) = delete;
+    RenderArena& operator=(const RenderArena&) = delete;
+
+    // Release everything handed out since the last reset. Chunks added while
+    // growing are merged into one, sized for the largest document so far.
+    void reset();
+
+    // Bytes handed out since the last reset
+    size_t used() const;
+
+    // Heap allocations made for chunks since the arena was created
+    size_t chunkAllocations() const;
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    void addChunk(size_t size);
+
+    std::vector<Chunk> chunks;
+    size_t offset;
+    size_t usedBytes;
+    size_t chunkCount;
+};
+
+#endif // ARENA_H
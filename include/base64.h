@@ -0,0 +1,42 @@
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <string>
+#include <string_view>
+
+// Incremental base64 decoder (RFC 4648 standard alphabet). The input can be
+// fed in pieces of any size. Whitespace anywhere is skipped, '=' padding is
+// only accepted at the end, and a missing final padding is tolerated.
+class Base64Decoder {
+public:
+    Base64Decoder();
+
+    // Append the bytes decoded from the next piece of input to out. Returns
+    // false, now and on every later call, once the input is invalid.
+    bool update(std::string_view input, std::string& out);
+
+    // Decode the last partial quantum; false if the input was invalid or
+    // ended in the middle of a quantum
+    bool finish(std::string& out);
+
+private:
+    unsigned char quantum[4];
+    int quantumLength;
+    int padding;
+    bool ended;
+    bool failed;
+};
+
+// Append the decoded bytes of a whole payload to out; false if it is not
+// valid base64
+bool base64Decode(std::string_view encoded, std::string& out);
+
+// Decoder used for runs of base64 characters: "avx2", "ssse3" or "scalar".
+// The fastest one the CPU supports is picked at startup.
+const char* base64Implementation();
+
+// Force a decoder by name (for benchmarks); returns false if this CPU or
+// build does not support it
+bool selectBase64Implementation(std::string_view name);
+
+#endif // BASE64_H
@@ -30,8 +30,6 @@ public:
 private:
     sqlite3* db;
     std::string dbPath;
-
-    std::string escapeJSON(const std::string& str);
 };
 
 #endif // BLOG_DATABASE_H
@@ -4,10 +4,17 @@
 #include "structures.h"
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
 
-// Simple hash function for content
+// Hash of content, stable across builds (see hash.h)
 size_t hashString(const std::string& str);
 
+// Hash stored for a post built from a source with content hash sourceHash
+// (hashBytes of the file); the same as hashString(source + templateHash)
+size_t pageHash(uint64_t sourceHash, const std::string& templateHash);
+
 // Load cache from file
 std::map<std::string, CachedMetadata> loadCache(const std::string& cacheFile);
 
@@ -19,8 +26,23 @@ bool needsPageRegeneration(const std::string& sourcePath, const std::string& out
                            const std::map<std::string, CachedMetadata>& cache);
 
 // Check if blog post needs regeneration based on content hash
-bool needsBlogRegeneration(const std::string& sourcePath, const std::string& sourceContent,
+bool needsBlogRegeneration(const std::string& sourcePath, uint64_t sourceHash,
                            const std::string& outputPath, const std::string& templateHash,
                            const std::map<std::string, CachedMetadata>& cache);
 
+// Load rendered markdown blocks and notebook cells saved by a previous build
+std::unordered_map<size_t, CachedBlock> loadBlockCache(const std::string& cacheFile);
+
+// Save rendered markdown blocks and notebook cells. Entries used in this
+// build are always kept; older ones are kept while the file stays under
+// maxBytes of HTML.
+void saveBlockCache(const std::string& cacheFile, const std::unordered_map<size_t, CachedBlock>& cache,
+                    size_t maxBytes);
+
+// Load the content hashes of images the PNG stage has already optimized
+std::unordered_set<uint64_t> loadImageCache(const std::string& cacheFile);
+
+// Save the content hashes of optimized images
+void saveImageCache(const std::string& cacheFile, const std::unordered_set<uint64_t>& cache);
+
 #endif // CACHE_H
@@ -0,0 +1,58 @@
+#ifndef DOCUMENT_STORE_H
+#define DOCUMENT_STORE_H
+
+#include "markdown_document.h"
+#include "structures.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+// Source file read once per build, with its parsed markdown document
+// (the document is left empty for non-markdown files such as notebooks).
+// Notebooks are parsed as they are read and never held whole.
+struct SourceFile {
+    size_t size = 0;                // Bytes in the file; 0 if empty or unreadable
+    uint64_t hash = 0;              // hashBytes of the file's content
+    std::string content;            // Markdown only
+    MarkdownDocument document;
+    NotebookInfo notebook;          // Notebooks only
+    std::string notebookHTML;       // Rendered notebook, empty until needed
+    bool released = false;          // Page written; see releaseSourceFile
+};
+
+// Read and parse a source file; later calls for the same path during this
+// build return the cached copy instead of touching the disk again. A
+// notebook's summary comes from the build cache when its content is
+// unchanged; otherwise the notebook is rendered here, in the one pass that
+// also produces the summary. Each file is read and parsed once per build:
+// after releaseSourceFile only its summary is left.
+const SourceFile& loadSourceFile(const std::string& filepath);
+
+// Drop a source's content, rendered HTML and all of its document but the
+// title and excerpt once its page has been written, keeping the size, hash
+// and notebook summary. Rendering a released source is a bug (asserted).
+void releaseSourceFile(const std::string& filepath);
+
+// How notebooks are rendered during this build
+struct NotebookSettings {
+    std::string imageDirectory = "docs/images/notebooks";
+    std::unordered_map<size_t, CachedBlock>* cellCache = nullptr;  // nullptr renders every cell
+    size_t outputBudget = 64 * 1024;    // See JupyterParser::setOutputBudget
+    size_t inlineImageBytes = 4 * 1024; // See JupyterParser::setInlineImageLimit
+};
+
+// Settings for every notebook rendered from now on, and the build cache
+// whose notebook summaries loadSourceFile may reuse. Call before the first
+// notebook is loaded.
+void configureNotebooks(const NotebookSettings& settings,
+                        const std::map<std::string, CachedMetadata>& cache);
+
+// Parsed markdown of a source whose page has not been written yet
+const MarkdownDocument& sourceDocument(const std::string& filepath);
+
+// Rendered HTML of a notebook, converted now unless loading it already did
+const std::string& renderNotebook(const std::string& filepath);
+
+#endif // DOCUMENT_STORE_H
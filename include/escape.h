@@ -0,0 +1,24 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+#include <string>
+#include <string_view>
+
+// Append str to out with < > & " ' replaced by HTML entities
+void escapeHTML(std::string_view str, std::string& out);
+std::string escapeHTML(std::string_view str);
+
+// Append str to out as the body of a JSON string literal (quotes,
+// backslashes and control characters escaped)
+void escapeJSON(std::string_view str, std::string& out);
+std::string escapeJSON(std::string_view str);
+
+// Scanner used to find bytes that need escaping: "avx2", "sse2" or
+// "scalar". The fastest one the CPU supports is picked at startup.
+const char* escapeImplementation();
+
+// Force a scanner by name (for benchmarks); returns false if this CPU or
+// build does not support it
+bool selectEscapeImplementation(std::string_view name);
+
+#endif // ESCAPE_H
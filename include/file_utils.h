@@ -1,7 +1,12 @@
 #ifndef FILE_UTILS_H
 #define FILE_UTILS_H
 
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <streambuf>
 #include <string>
+#include <vector>
 
 // Read entire file contents into a string
 std::string readFile(const std::string& filepath);
@@ -9,4 +14,32 @@ std::string readFile(const std::string& filepath);
 // Write string content to a file
 void writeFile(const std::string& filepath, const std::string& content);
 
+// Input buffer over a file that hashes (hashBytes) and counts the bytes as
+// they are read, so a parser streaming the file gets its hash in the same
+// pass without the file ever being held whole
+class HashingFileBuffer : public std::streambuf {
+public:
+    explicit HashingFileBuffer(const std::string& filepath);
+
+    bool is_open() const { return file.is_open(); }
+
+    // Read what is left of the file, so hash() and size() cover all of it
+    void finish();
+
+    uint64_t hash() const { return contentHash; }
+    size_t size() const { return bytesRead; }
+
+protected:
+    int_type underflow() override;
+
+private:
+    std::ifstream file;
+    std::vector<char> buffer;
+    uint64_t contentHash;
+    size_t bytesRead;
+};
+
+// Hash and size of a file's content, read in blocks; false if it can't be opened
+bool hashFile(const std::string& filepath, uint64_t& hash, size_t& size);
+
 #endif // FILE_UTILS_H
@@ -0,0 +1,52 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+// 64-bit FNV-1a of bytes, continuing from hash. Unlike std::hash it is the
+// same for every build, standard library and compiler, so everything saved
+// between builds (cache keys, image names) is hashed with it.
+inline uint64_t hashBytes(std::string_view bytes, uint64_t hash = FNV_OFFSET) {
+    for (unsigned char c : bytes) {
+        hash ^= c;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Key of a cache entry saved between builds, and a second hash of the same
+// inputs computed differently. The check is stored with the entry, so a
+// lookup whose key matches but whose check does not is a collision of two
+// different inputs, not a hit.
+struct CacheKey {
+    size_t hash;
+    uint64_t check;
+
+    explicit CacheKey(size_t kind = 0) : hash(kind), check(FNV_OFFSET) { mixCheck(kind); }
+
+    void mix(size_t value) {
+        hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        mixCheck(value);
+    }
+
+    void mixText(std::string_view text) {
+        hash ^= static_cast<size_t>(hashBytes(text)) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        mixCheck(text.size());
+        check = hashBytes(text, check);
+    }
+
+private:
+    void mixCheck(uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            check ^= (value >> (i * 8)) & 0xff;
+            check *= FNV_PRIME;
+        }
+    }
+};
+
+#endif // HASH_H
@@ -0,0 +1,22 @@
+#ifndef HIGHLIGHTER_H
+#define HIGHLIGHTER_H
+
+#include <string>
+#include <string_view>
+
+// Highlighter language for a code fence info string or notebook kernel
+// language ("py" -> "python", "shell" -> "bash", "c++" -> "cpp"), or an
+// empty view if the language is not supported
+std::string_view highlightLanguage(std::string_view name);
+
+// Append the opening <pre><code> of a code block; markdown fences and
+// notebook cells share it so one set of classes styles both. The class is
+// "language-" and the highlighter's name for the language (the name as
+// written if it has none), and is left out for an empty name.
+void appendCodeBlockStart(std::string_view name, std::string& out);
+
+// Append code as escaped HTML with Prism-style <span class="token ...">
+// markup. Returns false without writing anything for unsupported languages.
+bool highlightCode(std::string_view code, std::string_view language, std::string& out);
+
+#endif // HIGHLIGHTER_H
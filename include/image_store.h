@@ -0,0 +1,36 @@
+#ifndef IMAGE_STORE_H
+#define IMAGE_STORE_H
+
+#include <string>
+#include <string_view>
+
+// Content-addressed store for images extracted from notebooks. Each file is
+// named by a hash of its bytes. Identical images share one file across
+// notebooks, inserting a cell does not rename later images, and a name that
+// already exists never has to be written again, so the files can be served
+// with immutable cache headers. Oversized notebook outputs moved out of
+// their page are kept here the same way. A file may later be replaced by a
+// smaller encoding of the same image; it keeps the name of the original.
+class ImageStore {
+public:
+    explicit ImageStore(std::string directory);
+
+    // Decode a base64 payload into the store and return its file name (hash
+    // plus extension). Nothing is written if the name is already present.
+    // Throws std::runtime_error for invalid base64 or a failed write.
+    std::string storeBase64(std::string_view base64Data, std::string_view extension);
+
+    // Same for bytes that need no decoding
+    std::string storeBytes(std::string_view bytes, std::string_view extension);
+
+    // Atomically rewrite a stored file with equivalent bytes, keeping its
+    // name. Throws std::runtime_error if the write fails.
+    void replace(const std::string& filename, std::string_view bytes);
+
+    const std::string& directory() const { return root; }
+
+private:
+    std::string root;
+};
+
+#endif // IMAGE_STORE_H
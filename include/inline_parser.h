@@ -0,0 +1,59 @@
+#ifndef INLINE_PARSER_H
+#define INLINE_PARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Single-pass renderer for inline markdown (code spans, images, links,
+// bold, italic). Scratch buffers are kept between calls so rendering
+// line after line does not allocate once they have grown.
+//
+// Rendering is linear in the input length: bracket and parenthesis
+// lookaheads remember their last answer, failed link labels are not
+// re-walked, and the emphasis stack holds at most one opener per
+// delimiter kind.
+class InlineRenderer {
+public:
+    // Append the HTML for one piece of inline markdown to out
+    void render(std::string_view text, std::string& out);
+
+private:
+    // An emphasis run (* or _) written to the buffer, replaced by tag if matched
+    struct Delimiter {
+        size_t position;
+        size_t length;
+        char marker;
+        const char* tag;
+        bool nested;
+    };
+
+    // Last answer of a forward search: no match in [from, found)
+    struct SearchCache {
+        size_t from;
+        size_t found;
+    };
+
+    void scan(size_t begin, size_t end);
+    void processEmphasis(size_t first);
+    size_t findNext(SearchCache& cache, std::string_view pattern, size_t pos);
+    size_t findImage(size_t pos, size_t end, size_t& altEnd);
+    size_t findLink(size_t pos, size_t end, size_t& labelEnd);
+
+    std::string_view source;
+    SearchCache closeBracket;
+    SearchCache closeParen;
+    SearchCache imageOpen;
+    size_t failedLinkFrom;
+    size_t failedLinkUntil;
+    size_t failedLinkEnd;
+
+    std::vector<Delimiter> delimiters;
+    std::vector<size_t> openers;
+    std::string buffer;
+};
+
+// Render inline markdown to a new string
+std::string renderInline(const std::string& text);
+
+#endif // INLINE_PARSER_H
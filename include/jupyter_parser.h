@@ -1,68 +1,178 @@
 #ifndef JUPYTER_PARSER_H
 #define JUPYTER_PARSER_H
 
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include "json.hpp"
+#include "arena.h"
+#include "image_store.h"
+#include "markdown_parser.h"
+#include "structures.h"
 
 using json = nlohmann::json;
 
+// Kind of a cell output, from its output_type
+enum NotebookOutputType {
+    OUTPUT_STREAM,
+    OUTPUT_DISPLAY_DATA,
+    OUTPUT_EXECUTE_RESULT,
+    OUTPUT_ERROR,
+    OUTPUT_INVALID,     // Malformed output JSON; text holds the reason
+    OUTPUT_OTHER        // Unknown output_type, not rendered
+};
+
+// A cell output collected while the notebook is read. Image payloads are
+// taken over from the JSON reader and freed once written to disk, so no more
+// than one batch of cells' worth is held at a time.
+struct NotebookOutput {
+    NotebookOutputType type;
+    std::string_view mimeType;      // Representation to render ("text/plain" for streams), empty if none
+    std::pmr::string text;          // Stream text, textual representation, <img> tag, or why the output is invalid
+    std::string imageData;          // Base64 PNG/JPEG payload until it is saved
+    bool hasError;                  // Errors: ename and evalue are present
+    bool external;                  // Over the output budget: the full output is in a side file and text holds its preview
+    std::pmr::string errorName;
+    std::pmr::string errorValue;
+    std::pmr::vector<std::pmr::string> traceback;
+
+    explicit NotebookOutput(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : type(OUTPUT_OTHER), text(resource), hasError(false), external(false), errorName(resource),
+          errorValue(resource), traceback(resource) {}
+};
+
 struct NotebookCell {
-    std::string cellType;        // "code", "markdown", "raw"
-    std::string source;          // Combined source lines
-    std::vector<std::string> outputs; // HTML-rendered outputs
-    std::string language;        // "python", "r", "julia"
+    std::pmr::string cellType;   // "code", "markdown", "raw"
+    std::pmr::string source;     // Combined source lines
+    std::pmr::vector<NotebookOutput> outputs;
+    std::pmr::string language;   // "python", "r", "julia"
     int executionCount;          // Execution count for code cells
+
+    explicit NotebookCell(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : cellType(resource), source(resource), outputs(resource), language(resource), executionCount(0) {}
 };
 
 class JupyterParser {
 public:
-    JupyterParser();
+    // Extracted images are written straight into imageDirectory, the
+    // output tree's images/notebooks; the source tree is never touched
+    explicit JupyterParser(const std::string& imageDirectory);
 
-    // Main conversion function
+    // Main conversion function; info is filled in from the same pass
     std::string convertToHTML(const std::string& ipynbContent,
                                const std::string& notebookPath,
-                               std::vector<std::string>& extractedImages);
+                               std::vector<std::string>& extractedImages,
+                               NotebookInfo& info);
+
+    // Same, parsing the notebook as it is read from disk rather than from a
+    // copy of the whole file in memory
+    std::string convertFile(const std::string& notebookPath,
+                            std::vector<std::string>& extractedImages,
+                            NotebookInfo& info);
+
+    // Reuse HTML for cells, and image files for payloads, seen in an earlier
+    // build and record newly rendered ones. The entries live alongside the
+    // markdown blocks in the same cache. Pass nullptr to render every cell.
+    void setCellCache(std::unordered_map<size_t, CachedBlock>* cache);
+
+    // Outputs with more than this many bytes of text are written to a side
+    // file next to the images and replaced by a short preview that loads the
+    // rest when expanded (default 64 KB). SIZE_MAX keeps every output inline.
+    void setOutputBudget(size_t bytes);
+
+    // Images up to this many bytes stay in the page, PNG and JPEG as data:
+    // URIs and SVG as markup; larger ones are written to the image directory
+    // (default 4 KB). 0 writes every image to a file.
+    void setInlineImageLimit(size_t bytes);
 
 private:
-    // Parse .ipynb JSON structure
-    std::vector<NotebookCell> parseCells(const json& notebook);
+    // SAX handler that renders the cells in batches as they are read
+    class NotebookReader;
+
+    // Parse the notebook from input (text or a stream) and render it, with
+    // code cells read before the metadata in the guessed language. If the
+    // metadata names another, language is set to it and the HTML is not
+    // usable.
+    template <typename Input>
+    std::string convert(Input&& input, const std::string& notebookPath, std::string& language,
+                        std::vector<std::string>& extractedImages, NotebookInfo& info);
+
+    // Parser for another thread with the same image directory and every
+    // setting of this one
+    std::unique_ptr<JupyterParser> createHelper() const;
+
+    // Render a cell's markdown, or a code cell's input and outputs, moving
+    // oversized outputs out first. Returns true if some output is in a side
+    // file.
+    bool renderCell(NotebookCell& cell, const std::string& notebookPath, std::string& out);
 
     // Render individual cell types
-    std::string renderCodeCell(const NotebookCell& cell, int cellNumber);
-    std::string renderMarkdownCell(const NotebookCell& cell);
-    std::string renderOutputs(const std::vector<std::string>& outputs, int executionCount,
-                               const std::string& notebookPath, int cellNumber,
-                               std::vector<std::string>& extractedImages);
-
-    // Output parsers
-    std::string parseOutput(const json& output, const std::string& notebookPath,
-                            int cellNumber, int outputNumber,
-                            std::vector<std::string>& extractedImages);
-    std::string parseStreamOutput(const json& output);
-    std::string parseDisplayData(const json& output, const std::string& notebookPath,
-                                  int cellNumber, int outputNumber,
-                                  std::vector<std::string>& extractedImages);
-    std::string parseExecuteResult(const json& output, const std::string& notebookPath,
-                                    int cellNumber, int outputNumber,
-                                    std::vector<std::string>& extractedImages);
-    std::string parseErrorOutput(const json& output);
+    void renderCodeCell(const NotebookCell& cell, std::string& out);
+    void renderMarkdownCell(const NotebookCell& cell, std::string& out);
+    void renderOutputs(const NotebookCell& cell, std::string& out);
+
+    // Append the HTML cached under key, or produce it with render(out) and
+    // cache it. An entry is only used if usable(html) holds for it.
+    template <typename Render>
+    void renderCached(const CacheKey& key, std::string& out, Render render);
+    template <typename Render, typename Usable>
+    void renderCached(const CacheKey& key, std::string& out, Render render, Usable usable);
+
+    // Cache entries are looked up while cells render on several threads but
+    // recorded and inserted afterwards, by the thread that owns the cache
+    void applyCacheUpdates();
+
+    // Cache keys of everything a cell's markdown, code input or outputs HTML
+    // depends on
+    CacheKey markdownCellKey(const NotebookCell& cell);
+    CacheKey codeInputKey(const NotebookCell& cell);
+    CacheKey outputsKey(const NotebookCell& cell, const std::string& notebookPath);
+
+    // Output renderers
+    void renderStreamOutput(const NotebookOutput& output, std::string& out);
+    void renderDisplayData(const NotebookOutput& output, std::string& out);
+    void renderErrorOutput(const NotebookOutput& output, std::string& out);
+    void renderOutputBody(const NotebookOutput& output, std::string& out);
+
+    // Move an output over the budget to a side file, leaving its preview
+    bool overBudget(const NotebookOutput& output) const;
+    bool externalizeOutput(NotebookOutput& output, const std::string& notebookPath);
+
+    // Every side file that outputs HTML links to is in the image directory
+    bool sideFilesPresent(std::string_view html) const;
 
     // Image handling
-    std::string extractBase64Image(const std::string& base64Data,
-                                    const std::string& mimeType,
+    std::string extractBase64Image(std::string_view base64Data,
+                                    std::string_view mimeType,
                                     const std::string& notebookPath,
-                                    int cellNumber, int outputNumber,
+                                    int outputNumber,
                                     std::vector<std::string>& extractedImages);
-    std::string saveImage(const std::vector<unsigned char>& imageData,
-                          const std::string& outputPath);
-
-    // Helper functions
-    std::string escapeHTML(const std::string& str);
-    std::string joinLines(const json& lines);
-    std::string detectLanguage(const json& metadata);
-    std::string getPrismLanguageClass(const std::string& language);
-    std::string base64Decode(const std::string& encoded);
+    std::string extractSvgImage(std::string_view svg,
+                                const std::string& notebookPath,
+                                int outputNumber,
+                                std::vector<std::string>& extractedImages);
+    std::string storeImage(std::string_view base64Data, const std::string& extension);
+
+    // Relative URL of the image directory from the notebook's page
+    std::string imageURL(const std::string& notebookPath);
+
+    // Extracted images, named by content
+    ImageStore imageStore;
+
+    // Settings; createHelper copies each of them
+    std::unordered_map<size_t, CachedBlock>* cellCache;
+    size_t outputBudget;
+    size_t inlineImageBytes;
+
+    std::vector<CachedBlock*> cacheHits;
+    std::vector<std::pair<CacheKey, std::string>> cacheAdditions;
+
+    // Per-notebook temporaries, released after each conversion
+    RenderArena arena;
+    MarkdownParser markdownParser;
 };
 
 #endif
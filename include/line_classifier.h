@@ -0,0 +1,35 @@
+#ifndef LINE_CLASSIFIER_H
+#define LINE_CLASSIFIER_H
+
+#include <string_view>
+
+// What a markdown line starts, decided from its first non-blank byte
+enum LineKind {
+    LINE_EMPTY,
+    LINE_FENCE,          // ``` opening or closing a code block
+    LINE_TABLE_ROW,      // | cell | cell |
+    LINE_HEADING,        // # to ###### at the start of the line
+    LINE_BULLET_ITEM,    // - item or * item
+    LINE_ORDERED_ITEM,   // 1. item
+    LINE_PARAGRAPH
+};
+
+// A classified line. content is the part the block renders: the trimmed
+// line, a heading's text, a list item's text or a fence's info string.
+struct LineInfo {
+    LineKind kind;
+    size_t contentStart;
+    size_t contentEnd;
+    int level;           // Headings: number of #
+
+    LineInfo() : kind(LINE_EMPTY), contentStart(0), contentEnd(0), level(0) {}
+
+    std::string_view content(std::string_view line) const {
+        return line.substr(contentStart, contentEnd - contentStart);
+    }
+};
+
+// Classify one line with a single pass over its leading bytes
+LineInfo classifyLine(std::string_view line);
+
+#endif // LINE_CLASSIFIER_H
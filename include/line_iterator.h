@@ -0,0 +1,33 @@
+#ifndef LINE_ITERATOR_H
+#define LINE_ITERATOR_H
+
+#include <string_view>
+
+// Walks a text buffer line by line without copying, with the same line
+// boundaries as std::getline: '\n' is stripped and a trailing newline
+// does not produce an extra empty line
+class LineIterator {
+public:
+    explicit LineIterator(std::string_view text) : text(text), pos(0) {}
+
+    // Store the next line in line; returns false at the end of the text
+    bool next(std::string_view& line) {
+        if (pos >= text.length()) return false;
+
+        size_t newline = text.find('\n', pos);
+        if (newline == std::string_view::npos) {
+            line = text.substr(pos);
+            pos = text.length();
+        } else {
+            line = text.substr(pos, newline - pos);
+            pos = newline + 1;
+        }
+        return true;
+    }
+
+private:
+    std::string_view text;
+    size_t pos;
+};
+
+#endif // LINE_ITERATOR_H
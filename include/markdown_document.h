@@ -0,0 +1,59 @@
+#ifndef MARKDOWN_DOCUMENT_H
+#define MARKDOWN_DOCUMENT_H
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Top-level block types produced by the markdown parser
+enum MarkdownBlockType {
+    BLOCK_PARAGRAPH,
+    BLOCK_HEADING,
+    BLOCK_LIST,
+    BLOCK_CODE,
+    BLOCK_TABLE
+};
+
+// A top-level block: a run of lines in MarkdownDocument::lines
+struct MarkdownBlock {
+    MarkdownBlockType type;
+    size_t firstLine;
+    size_t lineCount;
+    bool ordered;      // Lists: <ol> instead of <ul>
+    bool closed;       // Code blocks: closing fence was found
+    std::string_view language;  // Code blocks: first word after the opening fence
+    bool continued;    // Streaming: began in an earlier window, whose HTML opened it
+    bool unfinished;   // Streaming: goes on in the next window, whose HTML closes it
+
+    MarkdownBlock()
+        : type(BLOCK_PARAGRAPH), firstLine(0), lineCount(0), ordered(false), closed(false), continued(false),
+          unfinished(false) {}
+};
+
+// Heading entry in the document outline
+struct MarkdownHeading {
+    int level;
+    std::string_view text;
+    std::pmr::string anchor;    // Unique within the document
+
+    explicit MarkdownHeading(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : level(0), anchor(resource) {}
+};
+
+// Markdown source parsed once and shared by title, excerpt, TOC and HTML.
+// Lines and heading text point into the source buffer, which must outlive
+// the document. Everything else is allocated from the given resource, so a
+// document rendered and dropped right away can live in a RenderArena.
+struct MarkdownDocument {
+    std::pmr::vector<std::string_view> lines;
+    std::pmr::vector<MarkdownBlock> blocks;
+    std::pmr::vector<MarkdownHeading> headings;
+    std::pmr::string title;
+    std::pmr::string excerpt;
+
+    explicit MarkdownDocument(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : lines(resource), blocks(resource), headings(resource), title(resource), excerpt(resource) {}
+};
+
+#endif // MARKDOWN_DOCUMENT_H
@@ -2,8 +2,18 @@
 #define MARKDOWN_PARSER_H
 
 #include <string>
+#include <istream>
+#include <ostream>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include "markdown_document.h"
+#include "inline_parser.h"
+#include "structures.h"
+#include "slug.h"
+#include "arena.h"
+#include "hash.h"
 
 class MarkdownParser {
 public:
@@ -12,29 +22,76 @@ public:
     // Main conversion function
     std::string convertToHTML(const std::string& markdown);
 
+    // Append the HTML for markdown to a caller-provided buffer. The parsed
+    // document only lives for this call, so it comes from the parser's arena.
+    void convertToHTML(std::string_view markdown, std::string& out);
+
+    // Parse markdown once into blocks, heading outline, title and excerpt.
+    // The document refers to markdown's memory, so keep it alive.
+    MarkdownDocument parseDocument(std::string_view markdown, size_t excerptLength = 200);
+
+    // Parse one window of a longer document; slugs carries heading anchors
+    // across windows so they stay unique
+    MarkdownDocument parseDocument(std::string_view markdown, SlugGenerator& slugs, size_t excerptLength = 200);
+
+    // Render a parsed document to HTML
+    std::string renderHTML(const MarkdownDocument& doc);
+    void renderHTML(const MarkdownDocument& doc, std::string& out);
+
+    // Reuse HTML for blocks whose source was rendered before and record newly
+    // rendered ones. Pass nullptr to render every block.
+    void setBlockCache(std::unordered_map<size_t, CachedBlock>* cache);
+
+    // Documents with at least this many bytes of block source render their
+    // blocks on the shared thread pool (default 1 MB). SIZE_MAX disables it.
+    void setParallelThreshold(size_t bytes);
+
+    // Render markdown from a stream, writing HTML to out as it goes. Input is
+    // read in windows of about bufferSize bytes that end at block boundaries.
+    // A block longer than a window is cut at a line and carried on in the
+    // next, so memory stays bounded by bufferSize (or by the longest line).
+    // The block cache is not used, since it would grow with the document.
+    void renderStream(std::istream& in, std::ostream& out, size_t bufferSize);
+
+    // Title of a markdown stream (first "# " line), reading only up to it
+    std::string readTitle(std::istream& in);
+
 private:
+    // Fill doc, whose memory resource the caller picked. If openBlock is set,
+    // the markdown starts inside a block of its kind left unfinished by the
+    // previous stream window.
+    void parseDocument(std::string_view markdown, SlugGenerator& slugs, size_t excerptLength,
+                       MarkdownDocument& doc, const MarkdownBlock* openBlock = nullptr);
+
+    void renderParallel(const MarkdownDocument& doc, size_t sourceBytes, std::string& out);
+    void renderBlock(const MarkdownDocument& doc, const MarkdownBlock& block,
+                     const std::pmr::string* anchorId, std::string& out);
+    CacheKey blockKey(const MarkdownDocument& doc, const MarkdownBlock& block, const std::pmr::string* anchorId);
+
     // Parse individual markdown elements
-    std::string parseHeaders(const std::string& line);
-    std::string parseBold(const std::string& line);
-    std::string parseItalic(const std::string& line);
-    std::string parseLinks(const std::string& line);
-    std::string parseImages(const std::string& line);
-    std::string parseInlineCode(const std::string& line);
-    std::string parseList(const std::string& line, bool& inList, bool& isOrdered);
-    std::string parseCodeBlock(const std::string& line, bool& inCodeBlock, std::string& codeContent);
-    std::string parseParagraph(const std::string& line);
-    std::string parseTable(std::vector<std::string>& tableLines);
+    void parseHeaders(std::string_view line, std::string_view anchorId, std::string& out);
+    void parseInline(std::string_view line, std::string& out);
+    void parseListItem(std::string_view line, std::string& out);
+    void parseCodeBlock(const MarkdownDocument& doc, const MarkdownBlock& block, std::string& out);
+    void parseParagraph(const MarkdownDocument& doc, const MarkdownBlock& block, std::string& out);
+    void parseTable(const MarkdownDocument& doc, const MarkdownBlock& block, std::string& out);
+    void parseTableAlignments(std::string_view delimiterRow);
+    void parseTableCell(std::string_view cell, const char* tag, size_t column, std::string& out);
 
     // Helper functions
-    bool isHeader(const std::string& line);
-    bool isListItem(const std::string& line);
-    bool isCodeBlockDelimiter(const std::string& line);
-    bool isEmptyLine(const std::string& line);
-    bool isTableRow(const std::string& line);
-    bool isTableDelimiter(const std::string& line);
-    std::vector<std::string> splitTableRow(const std::string& line);
-    std::string trim(const std::string& str);
-    std::string escapeHTML(const std::string& str);
+    bool isTableDelimiter(std::string_view line);
+    void splitTableRow(std::string_view line, std::vector<std::string_view>& cells);
+    std::string_view trim(std::string_view str);
+
+    InlineRenderer inlineRenderer;
+    std::vector<std::string_view> tableCells;
+    std::vector<const char*> tableAlignments;
+    std::string tableCellText;
+    std::unordered_map<size_t, CachedBlock>* blockCache;
+    size_t parallelThreshold;
+
+    // Per-render temporaries, released after each document
+    RenderArena arena;
 };
 
 #endif
@@ -0,0 +1,34 @@
+#ifndef PNG_OPTIMIZER_H
+#define PNG_OPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+// Lossless re-encoding of PNG files with zlib. The pixels are unfiltered,
+// filtered again with each PNG filter strategy and deflated at maximum
+// compression, and the smallest result wins. Ancillary chunks are dropped
+// except the ones that change how the image looks (transparency and color
+// space).
+//
+// Returns true and sets output only if the re-encoded file is smaller than
+// input. Interlaced, animated and damaged files are left alone.
+bool recompressPNG(std::string_view input, std::string& output);
+
+struct PNGOptimizeStats {
+    size_t files = 0;       // PNG files in the directory
+    size_t cached = 0;      // skipped, already optimized by an earlier build
+    size_t recompressed = 0;
+    size_t bytesBefore = 0; // of the recompressed files
+    size_t bytesAfter = 0;
+};
+
+// Recompress every .png in directory in place, in parallel on the shared
+// thread pool. optimized holds the content hashes of files an earlier build
+// already handled, which are skipped; on return it holds the hashes of the
+// files now in the directory.
+PNGOptimizeStats optimizePNGImages(const std::string& directory, std::unordered_set<uint64_t>& optimized);
+
+#endif // PNG_OPTIMIZER_H
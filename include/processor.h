@@ -25,4 +25,11 @@ void processCategoryBlogs(const std::string& categoryDir, const std::string& cat
                          std::map<std::string, CachedMetadata>& newCache,
                          const std::string& templateHash, MarkdownParser& parser);
 
+// Render a large markdown page straight from its source file into the
+// template and the output file, holding at most about bufferSize bytes
+bool streamMarkdownPage(const std::string& sourcePath, const std::string& outputPath,
+                        const std::string& templateContent, const std::string& title,
+                        const std::vector<Page>& pages, int subdirectoryDepth,
+                        MarkdownParser& parser, size_t bufferSize);
+
 #endif // PROCESSOR_H
@@ -0,0 +1,29 @@
+#ifndef SLUG_H
+#define SLUG_H
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+// Anchor id for heading text: ASCII letters lowercased, spaces turned into
+// hyphens, everything else except digits and hyphens dropped
+std::string slugify(std::string_view text);
+
+// Hands out unique anchor ids for the headings of one document. A repeated
+// slug gets -1, -2, ... appended, skipping ids that are already taken.
+class SlugGenerator {
+public:
+    explicit SlugGenerator(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // Unique anchor id for the next heading with this text, allocated from
+    // the generator's memory resource
+    std::pmr::string next(std::string_view text);
+
+private:
+    std::pmr::unordered_set<std::pmr::string> used;
+    std::pmr::unordered_map<std::pmr::string, int> lastSuffix;
+};
+
+#endif // SLUG_H
@@ -1,6 +1,7 @@
 #ifndef STRUCTURES_H
 #define STRUCTURES_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <ctime>
@@ -11,6 +12,7 @@ struct Page {
     std::string title;
     std::string content;
     std::string outputPath;
+    std::string sourcePath;    // Set when content is streamed from the source at write time
 };
 
 // Blog post structure
@@ -19,10 +21,23 @@ struct BlogPost {
     std::string title;
     std::string content;
     std::string excerpt;
+    std::string toc;
     std::string outputPath;
     std::string publishDate;
     std::time_t timestamp;
     std::string category;
+    std::string sourcePath;   // Rendered from this file when written, if set
+};
+
+// Summary of a notebook, filled in by the pass that renders it
+struct NotebookInfo {
+    size_t sourceHash = 0;        // hashString of the .ipynb it describes
+    std::string title;            // From the first "# " markdown cell, empty if none
+    std::string language;         // Kernel language
+    int cellCount = 0;
+    int outputCount = 0;
+    size_t outputBytes = 0;       // Text and base64 image bytes of all outputs
+    int imageCount = 0;
 };
 
 // Cached metadata for incremental builds
@@ -31,6 +46,17 @@ struct CachedMetadata {
     std::string publishDate;
     std::time_t timestamp;
     std::time_t fileModTime;
+    bool hasNotebook = false;     // Notebooks: summary below is filled in
+    NotebookInfo notebook;
+};
+
+// Rendered HTML of one markdown block, keyed by a hash of its source
+struct CachedBlock {
+    std::string html;
+    uint64_t check;    // CacheKey::check of the inputs it was rendered from
+    bool used;         // Rendered or reused during this build
+
+    CachedBlock() : check(0), used(false) {}
 };
 
 // Node types for content tree
@@ -10,4 +10,15 @@ std::string applyTemplate(const std::string& templateContent, const std::string&
                           const std::string& content, const std::vector<Page>& pages,
                           int subdirectoryDepth = 0, const std::string& toc = "");
 
+// Apply the template around its {{CONTENT}} slot: head gets everything
+// before the slot and tail everything after it, so large content can be
+// streamed between them
+void applyTemplateParts(const std::string& templateContent, const std::string& title,
+                        const std::vector<Page>& pages, int subdirectoryDepth, const std::string& toc,
+                        std::string& head, std::string& tail);
+
+// Remove the client-side highlighting sections (between CLIENT_HIGHLIGHT_BEGIN
+// and CLIENT_HIGHLIGHT_END comments) when code is highlighted at build time
+std::string stripClientHighlighting(const std::string& templateContent);
+
 #endif // TEMPLATE_H
@@ -0,0 +1,44 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for jobs that split into independent tasks
+class ThreadPool {
+public:
+    // Run tasks on this many threads in total, counting the thread that
+    // calls parallelFor; 0 uses one per hardware thread
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Threads that run tasks, including the caller
+    size_t concurrency() const;
+
+    // Run task(i) for every i in [0, count) and return once all are done.
+    // The calling thread takes tasks too, so nested calls cannot deadlock.
+    // The first exception thrown by a task is rethrown here.
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+    // Process-wide pool sized to the machine
+    static ThreadPool& shared();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+};
+
+#endif // THREAD_POOL_H
@@ -1,9 +1,10 @@
 #ifndef TOC_H
 #define TOC_H
 
+#include "markdown_document.h"
 #include <string>
 
-// Generate table of contents from markdown headings
-std::string generateTOC(const std::string& markdown);
+// Generate table of contents from a parsed document's heading outline
+std::string generateTOC(const MarkdownDocument& doc);
 
 #endif // TOC_H
@@ -0,0 +1,61 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstdint>
+
+RenderArena::RenderArena(size_t initialSize) : offset(0), usedBytes(0), chunkCount(0) {
+    addChunk(std::max<size_t>(initialSize, 64));
+}
+
+void RenderArena::reset() {
+    if (chunks.size() > 1) {
+        size_t total = 0;
+        for (const auto& chunk : chunks) {
+            total += chunk.size;
+        }
+        chunks.clear();
+        addChunk(total);
+    }
+    offset = 0;
+    usedBytes = 0;
+}
+
+size_t RenderArena::used() const {
+    return usedBytes;
+}
+
+size_t RenderArena::chunkAllocations() const {
+    return chunkCount;
+}
+
+void RenderArena::addChunk(size_t size) {
+    // Not zero-filled: callers construct into what they get
+    chunks.push_back(Chunk{std::unique_ptr<char[]>(new char[size]), size});
+    chunkCount++;
+    offset = 0;
+}
+
+void* RenderArena::do_allocate(size_t bytes, size_t alignment) {
+    Chunk* chunk = &chunks.back();
+    uintptr_t base = reinterpret_cast<uintptr_t>(chunk->data.get());
+    uintptr_t start = (base + offset + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+
+    if (start + bytes > base + chunk->size) {
+        // Grow geometrically so a large document needs few chunks
+        addChunk(std::max(chunk->size * 2, bytes + alignment));
+        chunk = &chunks.back();
+        base = reinterpret_cast<uintptr_t>(chunk->data.get());
+        start = (base + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+    }
+
+    offset = start + bytes - base;
+    usedBytes += bytes;
+    return reinterpret_cast<void*>(start);
+}
+
+void RenderArena::do_deallocate(void*, size_t, size_t) {
+    // Memory comes back all at once in reset()
+}
+
+bool RenderArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
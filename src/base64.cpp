@@ -0,0 +1,295 @@
+#include "base64.h"
+#include <array>
+
+// The SIMD decoders are compiled per function and only used when the CPU
+// reports support for them
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BASE64_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Decodes whole 4-character quanta from the start of data for as long as
+// they contain only alphabet characters. Returns the number of characters
+// consumed (a multiple of 4) and writes 3 bytes per quantum to out, which
+// must have 8 bytes of slack past the decoded bytes for vector stores.
+typedef size_t (*DecodeFunction)(const char* data, size_t length, char* out);
+
+struct Decoder {
+    const char* name;
+    DecodeFunction decode;
+};
+
+// Table values: 0-63 for alphabet characters, or one of these
+const unsigned char INVALID = 0x80;
+const unsigned char WHITESPACE = 0x81;
+const unsigned char PADDING = 0x82;
+
+constexpr std::array<unsigned char, 256> buildDecodeTable() {
+    const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::array<unsigned char, 256> table{};
+    for (auto& value : table) {
+        value = INVALID;
+    }
+    for (int i = 0; i < 64; i++) {
+        table[static_cast<unsigned char>(alphabet[i])] = static_cast<unsigned char>(i);
+    }
+    table[' '] = WHITESPACE;
+    table['\t'] = WHITESPACE;
+    table['\r'] = WHITESPACE;
+    table['\n'] = WHITESPACE;
+    table['='] = PADDING;
+    return table;
+}
+
+constexpr std::array<unsigned char, 256> DECODE_TABLE = buildDecodeTable();
+
+size_t decodeScalar(const char* data, size_t length, char* out) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        unsigned a = DECODE_TABLE[in[i]];
+        unsigned b = DECODE_TABLE[in[i + 1]];
+        unsigned c = DECODE_TABLE[in[i + 2]];
+        unsigned d = DECODE_TABLE[in[i + 3]];
+        if ((a | b | c | d) & 0x80) break;
+
+        unsigned bits = (a << 18) | (b << 12) | (c << 6) | d;
+        *out++ = static_cast<char>(bits >> 16);
+        *out++ = static_cast<char>(bits >> 8);
+        *out++ = static_cast<char>(bits);
+    }
+    return i;
+}
+
+const Decoder SCALAR_DECODER = {"scalar", decodeScalar};
+
+#ifdef BASE64_SIMD
+
+// Characters are classified by their high and low nibble (two pshufb
+// lookups whose AND is non-zero for anything outside the alphabet) and
+// turned into 6-bit values by adding an offset picked by the high nibble,
+// with '/' as the one exception. maddubs/madd then pack four 6-bit values
+// into 24 bits per lane. See Muła and Lemire, "Faster Base64 Encoding and
+// Decoding using AVX2 Instructions".
+
+__attribute__((target("ssse3")))
+size_t decodeSSSE3(const char* data, size_t length, char* out) {
+    const __m128i lowLookup = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i highLookup = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i offsets = _mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71,
+        0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i slash = _mm_set1_epi8('/');
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i high = _mm_and_si128(_mm_srli_epi32(chunk, 4), nibble);
+        __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lowLookup, _mm_and_si128(chunk, nibble)),
+                                        _mm_shuffle_epi8(highLookup, high));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(invalid, _mm_setzero_si128())) != 0xFFFF) break;
+
+        __m128i offset = _mm_shuffle_epi8(offsets, _mm_add_epi8(_mm_cmpeq_epi8(chunk, slash), high));
+        __m128i values = _mm_add_epi8(chunk, offset);
+        __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(words, pack));
+        out += 12;
+    }
+    return i + decodeScalar(data + i, length - i, out);
+}
+
+const Decoder SSSE3_DECODER = {"ssse3", decodeSSSE3};
+
+// Same steps on 32 characters; the packed bytes of the two lanes are then
+// moved together with a cross-lane permute
+__attribute__((target("avx2")))
+size_t decodeAVX2(const char* data, size_t length, char* out) {
+    const __m256i lowLookup = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i highLookup = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i offsets = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71,
+        0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71,
+        0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i slash = _mm256_set1_epi8('/');
+    const __m256i pack = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i high = _mm256_and_si256(_mm256_srli_epi32(chunk, 4), nibble);
+        __m256i invalid = _mm256_and_si256(_mm256_shuffle_epi8(lowLookup, _mm256_and_si256(chunk, nibble)),
+                                           _mm256_shuffle_epi8(highLookup, high));
+        if (!_mm256_testz_si256(invalid, invalid)) break;
+
+        __m256i offset = _mm256_shuffle_epi8(offsets, _mm256_add_epi8(_mm256_cmpeq_epi8(chunk, slash), high));
+        __m256i values = _mm256_add_epi8(chunk, offset);
+        __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(words, pack), lanes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), packed);
+        out += 24;
+    }
+    // Scalar tail: SSE code here would pay for the dirty upper YMM state
+    return i + decodeScalar(data + i, length - i, out);
+}
+
+const Decoder AVX2_DECODER = {"avx2", decodeAVX2};
+
+bool cpuHasSSSE3() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+
+bool cpuHasAVX2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // BASE64_SIMD
+
+const Decoder* detectDecoder() {
+#ifdef BASE64_SIMD
+    if (cpuHasAVX2()) return &AVX2_DECODER;
+    if (cpuHasSSSE3()) return &SSSE3_DECODER;
+#endif
+    return &SCALAR_DECODER;
+}
+
+const Decoder*& activeDecoder() {
+    static const Decoder* decoder = detectDecoder();
+    return decoder;
+}
+
+// Room past the decoded bytes for the widest vector store
+const size_t STORE_SLACK = 8;
+
+} // namespace
+
+Base64Decoder::Base64Decoder()
+    : quantum{}, quantumLength(0), padding(0), ended(false), failed(false) {}
+
+bool Base64Decoder::update(std::string_view input, std::string& out) {
+    if (failed) return false;
+
+    // Size for the input without whitespace once, trim afterwards
+    size_t start = out.size();
+    out.resize(start + (quantumLength + input.size()) / 4 * 3 + STORE_SLACK);
+    char* dst = &out[start];
+
+    DecodeFunction decode = activeDecoder()->decode;
+    const char* src = input.data();
+    const char* end = src + input.size();
+    while (src < end) {
+        // Runs of whole quanta go through the bulk decoder; it stops at
+        // whitespace, padding and invalid characters
+        if (quantumLength == 0 && padding == 0) {
+            size_t consumed = decode(src, end - src, dst);
+            src += consumed;
+            dst += consumed / 4 * 3;
+            if (src == end) break;
+        }
+
+        unsigned char value = DECODE_TABLE[static_cast<unsigned char>(*src++)];
+        if (value < 64) {
+            if (padding > 0) {
+                failed = true;
+                break;
+            }
+            quantum[quantumLength++] = value;
+            if (quantumLength == 4) {
+                *dst++ = static_cast<char>((quantum[0] << 2) | (quantum[1] >> 4));
+                *dst++ = static_cast<char>((quantum[1] << 4) | (quantum[2] >> 2));
+                *dst++ = static_cast<char>((quantum[2] << 6) | quantum[3]);
+                quantumLength = 0;
+            }
+        } else if (value == PADDING) {
+            // "xx==" or "xxx=" ends the payload
+            if (ended || quantumLength < 2) {
+                failed = true;
+                break;
+            }
+            padding++;
+            if (quantumLength + padding == 4) {
+                *dst++ = static_cast<char>((quantum[0] << 2) | (quantum[1] >> 4));
+                if (quantumLength == 3) {
+                    *dst++ = static_cast<char>((quantum[1] << 4) | (quantum[2] >> 2));
+                }
+                quantumLength = 0;
+                ended = true;
+            }
+        } else if (value != WHITESPACE) {
+            failed = true;
+            break;
+        }
+    }
+
+    out.resize(dst - out.data());
+    return !failed;
+}
+
+bool Base64Decoder::finish(std::string& out) {
+    if (failed || quantumLength == 1 || (padding > 0 && !ended)) {
+        failed = true;
+        return false;
+    }
+
+    // Unpadded final quantum
+    if (quantumLength >= 2) {
+        out += static_cast<char>((quantum[0] << 2) | (quantum[1] >> 4));
+        if (quantumLength == 3) {
+            out += static_cast<char>((quantum[1] << 4) | (quantum[2] >> 2));
+        }
+        quantumLength = 0;
+    }
+    return true;
+}
+
+bool base64Decode(std::string_view encoded, std::string& out) {
+    Base64Decoder decoder;
+    return decoder.update(encoded, out) && decoder.finish(out);
+}
+
+const char* base64Implementation() {
+    return activeDecoder()->name;
+}
+
+bool selectBase64Implementation(std::string_view name) {
+    if (name == SCALAR_DECODER.name) {
+        activeDecoder() = &SCALAR_DECODER;
+        return true;
+    }
+#ifdef BASE64_SIMD
+    if (name == SSSE3_DECODER.name && cpuHasSSSE3()) {
+        activeDecoder() = &SSSE3_DECODER;
+        return true;
+    }
+    if (name == AVX2_DECODER.name && cpuHasAVX2()) {
+        activeDecoder() = &AVX2_DECODER;
+        return true;
+    }
+#endif
+    return false;
+}
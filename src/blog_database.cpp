@@ -1,4 +1,5 @@
 #include "../include/blog_database.h"
+#include "../include/escape.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -110,34 +111,6 @@ std::vector<BlogEntry> BlogDatabase::getAllBlogs() {
     return blogs;
 }
 
-std::string BlogDatabase::escapeJSON(const std::string& str) {
-    std::string escaped;
-    escaped.reserve(str.length());
-
-    for (char c : str) {
-        switch (c) {
-            case '"':  escaped += "\\\""; break;
-            case '\\': escaped += "\\\\"; break;
-            case '\b': escaped += "\\b"; break;
-            case '\f': escaped += "\\f"; break;
-            case '\n': escaped += "\\n"; break;
-            case '\r': escaped += "\\r"; break;
-            case '\t': escaped += "\\t"; break;
-            default:
-                if (c >= 0 && c < 32) {
-                    // Control characters
-                    char buf[7];
-                    snprintf(buf, sizeof(buf), "\\u%04x", c);
-                    escaped += buf;
-                } else {
-                    escaped += c;
-                }
-        }
-    }
-
-    return escaped;
-}
-
 bool BlogDatabase::exportToJSON(const std::string& jsonPath) {
     std::vector<BlogEntry> blogs = getAllBlogs();
 
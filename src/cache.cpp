@@ -1,16 +1,67 @@
 #include "cache.h"
+#include "hash.h"
 #include "metadata.h"
 #include <fstream>
 #include <sstream>
-#include <functional>
 #include <filesystem>
 
 namespace fs = std::filesystem;
 
 size_t hashString(const std::string& str) {
-    return std::hash<std::string>{}(str);
+    return static_cast<size_t>(hashBytes(str));
 }
 
+size_t pageHash(uint64_t sourceHash, const std::string& templateHash) {
+    return static_cast<size_t>(hashBytes(templateHash, sourceHash));
+}
+
+namespace {
+
+// Notebook titles may hold tabs and newlines, which separate cache fields
+// and entries
+std::string escapeField(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '\\') escaped += "\\\\";
+        else if (c == '\t') escaped += "\\t";
+        else if (c == '\n') escaped += "\\n";
+        else escaped += c;
+    }
+    return escaped;
+}
+
+std::string unescapeField(const std::string& text) {
+    std::string unescaped;
+    for (size_t i = 0; i < text.length(); i++) {
+        if (text[i] == '\\' && i + 1 < text.length()) {
+            char next = text[++i];
+            unescaped += next == 't' ? '\t' : next == 'n' ? '\n' : next;
+        } else {
+            unescaped += text[i];
+        }
+    }
+    return unescaped;
+}
+
+// Notebook summary after the publish date:
+// "\tsourceHash cells outputs outputBytes images\tlanguage\ttitle"
+bool parseNotebookInfo(const std::string& text, NotebookInfo& info) {
+    size_t languageTab = text.find('\t');
+    if (languageTab == std::string::npos) return false;
+    size_t titleTab = text.find('\t', languageTab + 1);
+    if (titleTab == std::string::npos) return false;
+
+    std::stringstream counts(text.substr(0, languageTab));
+    if (!(counts >> info.sourceHash >> info.cellCount >> info.outputCount >> info.outputBytes >> info.imageCount)) {
+        return false;
+    }
+    info.language = unescapeField(text.substr(languageTab + 1, titleTab - languageTab - 1));
+    info.title = unescapeField(text.substr(titleTab + 1));
+    return true;
+}
+
+} // namespace
+
 std::map<std::string, CachedMetadata> loadCache(const std::string& cacheFile) {
     std::map<std::string, CachedMetadata> cache;
     std::ifstream file(cacheFile);
@@ -31,6 +82,13 @@ std::map<std::string, CachedMetadata> loadCache(const std::string& cacheFile) {
                 metadata.publishDate = metadata.publishDate.substr(1);
             }
 
+            // Notebooks carry their summary after a tab
+            size_t tab = metadata.publishDate.find('\t');
+            if (tab != std::string::npos) {
+                metadata.hasNotebook = parseNotebookInfo(metadata.publishDate.substr(tab + 1), metadata.notebook);
+                metadata.publishDate.erase(tab);
+            }
+
             cache[filepath] = metadata;
         }
         file.close();
@@ -46,12 +104,114 @@ void saveCache(const std::string& cacheFile, const std::map<std::string, CachedM
                  << entry.second.contentHash << " "
                  << entry.second.timestamp << " "
                  << entry.second.fileModTime << " "
-                 << entry.second.publishDate << "\n";
+                 << entry.second.publishDate;
+            if (entry.second.hasNotebook) {
+                const NotebookInfo& info = entry.second.notebook;
+                file << "\t" << info.sourceHash << " " << info.cellCount << " " << info.outputCount << " "
+                     << info.outputBytes << " " << info.imageCount << "\t"
+                     << escapeField(info.language) << "\t" << escapeField(info.title);
+            }
+            file << "\n";
         }
         file.close();
     }
 }
 
+// Bump when the markdown or notebook renderer's output, or how its keys are
+// hashed, changes so stale HTML is dropped
+static const char* BLOCK_CACHE_VERSION = "blocks 6";
+
+std::unordered_map<size_t, CachedBlock> loadBlockCache(const std::string& cacheFile) {
+    std::unordered_map<size_t, CachedBlock> cache;
+    std::ifstream file(cacheFile, std::ios::binary);
+    if (!file.is_open()) {
+        return cache;
+    }
+
+    std::string line;
+    if (!std::getline(file, line) || line != BLOCK_CACHE_VERSION) {
+        return cache;
+    }
+
+    // Each entry: "hash check length" line, then length bytes of HTML and a
+    // newline
+    while (std::getline(file, line)) {
+        std::stringstream ss(line);
+        size_t hash = 0;
+        uint64_t check = 0;
+        size_t length = 0;
+        if (!(ss >> hash >> check >> length)) break;
+
+        CachedBlock block;
+        block.check = check;
+        block.html.resize(length);
+        if (!file.read(&block.html[0], length) || file.get() != '\n') break;
+        cache[hash] = std::move(block);
+    }
+
+    return cache;
+}
+
+void saveBlockCache(const std::string& cacheFile, const std::unordered_map<size_t, CachedBlock>& cache,
+                    size_t maxBytes) {
+    std::ofstream file(cacheFile, std::ios::binary);
+    if (!file.is_open()) {
+        return;
+    }
+
+    file << BLOCK_CACHE_VERSION << "\n";
+
+    size_t written = 0;
+    auto writeBlock = [&](size_t hash, const CachedBlock& block) {
+        file << hash << " " << block.check << " " << block.html.size() << "\n" << block.html << "\n";
+        written += block.html.size();
+    };
+
+    for (const auto& entry : cache) {
+        if (entry.second.used) writeBlock(entry.first, entry.second);
+    }
+    for (const auto& entry : cache) {
+        if (!entry.second.used && written + entry.second.html.size() <= maxBytes) {
+            writeBlock(entry.first, entry.second);
+        }
+    }
+}
+
+// Bump when the PNG optimizer gets better so existing images are tried again
+static const char* IMAGE_CACHE_VERSION = "png 1";
+
+std::unordered_set<uint64_t> loadImageCache(const std::string& cacheFile) {
+    std::unordered_set<uint64_t> cache;
+    std::ifstream file(cacheFile);
+    if (!file.is_open()) {
+        return cache;
+    }
+
+    std::string line;
+    if (!std::getline(file, line) || line != IMAGE_CACHE_VERSION) {
+        return cache;
+    }
+
+    uint64_t hash = 0;
+    while (file >> hash) {
+        cache.insert(hash);
+    }
+
+    return cache;
+}
+
+void saveImageCache(const std::string& cacheFile, const std::unordered_set<uint64_t>& cache) {
+    std::ofstream file(cacheFile);
+    if (!file.is_open()) {
+        return;
+    }
+
+    file << IMAGE_CACHE_VERSION << "\n";
+    for (uint64_t hash : cache) {
+        file << hash << "\n";
+    }
+}
+
 bool needsPageRegeneration(const std::string& sourcePath, const std::string& outputPath,
                            const std::map<std::string, CachedMetadata>& cache) {
     // If output doesn't exist, needs regeneration
@@ -71,7 +231,7 @@ bool needsPageRegeneration(const std::string& sourcePath, const std::string& out
     return false; // File unchanged
 }
 
-bool needsBlogRegeneration(const std::string& sourcePath, const std::string& sourceContent,
+bool needsBlogRegeneration(const std::string& sourcePath, uint64_t sourceHash,
                            const std::string& outputPath, const std::string& templateHash,
                            const std::map<std::string, CachedMetadata>& cache) {
     // If output doesn't exist, needs regeneration
@@ -80,7 +240,7 @@ bool needsBlogRegeneration(const std::string& sourcePath, const std::string& sou
     }
 
     // Calculate hash of current content
-    size_t currentHash = hashString(sourceContent + templateHash);
+    size_t currentHash = pageHash(sourceHash, templateHash);
 
     // Check if cached hash exists and matches
     auto it = cache.find(sourcePath);
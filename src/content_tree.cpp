@@ -1,7 +1,6 @@
 #include "content_tree.h"
-#include "file_utils.h"
+#include "document_store.h"
 #include "metadata.h"
-#include "jupyter_parser.h"
 #include <filesystem>
 #include <algorithm>
 #include <iostream>
@@ -9,9 +8,6 @@
 
 namespace fs = std::filesystem;
 
-// Forward declaration for JSON parsing
-using json = nlohmann::json;
-
 std::string formatDisplayName(const std::string& name) {
     std::string display = name;
 
@@ -112,47 +108,21 @@ ContentNode* buildContentTree(const std::string& rootPath,
             node->name = fs::path(rootPath).filename().string();
 
             // Read and parse file (basic metadata extraction)
-            std::string fileContent = readFile(rootPath);
-            if (!fileContent.empty()) {
+            const SourceFile& source = loadSourceFile(rootPath);
+            if (source.size > 0) {
                 if (extension == ".ipynb") {
-                    // Extract title from first markdown cell in notebook
-                    try {
-                        json notebook = json::parse(fileContent);
-                        bool foundTitle = false;
-                        if (notebook.contains("cells")) {
-                            for (const auto& cell : notebook["cells"]) {
-                                if (cell["cell_type"] == "markdown" && cell.contains("source")) {
-                                    std::string source;
-                                    if (cell["source"].is_string()) {
-                                        source = cell["source"];
-                                    } else if (cell["source"].is_array() && !cell["source"].empty()) {
-                                        source = cell["source"][0];
-                                    }
-                                    if (source.find("# ") == 0) {
-                                        node->title = source.substr(2);
-                                        // Remove newline
-                                        if (!node->title.empty() && node->title.back() == '\n') {
-                                            node->title.pop_back();
-                                        }
-                                        foundTitle = true;
-                                        break;
-                                    }
-                                }
-                            }
-                        }
-                        if (!foundTitle) {
-                            node->title = fs::path(rootPath).stem().string();
-                        }
-                    } catch (...) {
+                    // Title from the notebook's first "# " heading
+                    node->title = source.notebook.title;
+                    if (node->title.empty()) {
                         node->title = fs::path(rootPath).stem().string();
                     }
                     node->displayName = node->title;
                     node->excerpt = "Jupyter notebook";
                 } else {
                     // Markdown file
-                    node->title = extractTitle(fileContent);
+                    node->title = source.document.title;
                     node->displayName = node->title;
-                    node->excerpt = extractExcerpt(fileContent);
+                    node->excerpt = source.document.excerpt;
                 }
                 node->publishDate = getFileModificationDate(rootPath);
                 node->timestamp = getFileModificationTimestamp(rootPath);
@@ -0,0 +1,142 @@
+#include "document_store.h"
+#include "cache.h"
+#include "file_utils.h"
+#include "hash.h"
+#include "jupyter_parser.h"
+#include "markdown_parser.h"
+#include <cassert>
+#include <filesystem>
+#include <iostream>
+#include <map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::map<std::string, SourceFile>& sourceStore() {
+    static std::map<std::string, SourceFile> store;
+    return store;
+}
+
+NotebookSettings notebookSettings;
+
+// Summaries from the previous build, by normalized path
+std::map<std::string, NotebookInfo> cachedNotebooks;
+
+// Different walks spell the same file differently (e.g. separators)
+std::string storeKey(const std::string& filepath) {
+    return fs::path(filepath).lexically_normal().generic_string();
+}
+
+void convertNotebook(const std::string& filepath, SourceFile& source) {
+    JupyterParser jupyterParser(notebookSettings.imageDirectory);
+    jupyterParser.setCellCache(notebookSettings.cellCache);
+    jupyterParser.setOutputBudget(notebookSettings.outputBudget);
+    jupyterParser.setInlineImageLimit(notebookSettings.inlineImageBytes);
+    std::vector<std::string> extractedImages;
+    source.notebookHTML = jupyterParser.convertFile(filepath, extractedImages, source.notebook);
+}
+
+void loadMarkdown(const std::string& filepath, SourceFile& source) {
+    source.content = readFile(filepath);
+    source.size = source.content.size();
+    source.hash = hashBytes(source.content);
+    if (!source.content.empty()) {
+        MarkdownParser parser;
+        source.document = parser.parseDocument(source.content);
+    }
+}
+
+// Only a notebook whose summary is out of date is rendered; its hash comes
+// from the same read of the file as the rendering
+void loadNotebook(const std::string& filepath, const std::string& key, SourceFile& source) {
+    std::error_code error;
+    uintmax_t size = fs::file_size(filepath, error);
+    if (error) {
+        std::cerr << "Error: Could not open file " << filepath << std::endl;
+        return;
+    }
+    if (size == 0) {
+        return;
+    }
+
+    auto cached = cachedNotebooks.find(key);
+    if (cached != cachedNotebooks.end() && hashFile(filepath, source.hash, source.size) &&
+        cached->second.sourceHash == static_cast<size_t>(source.hash)) {
+        source.notebook = cached->second;
+        return;
+    }
+
+    convertNotebook(filepath, source);
+    source.hash = source.notebook.sourceHash;
+    source.size = static_cast<size_t>(size);
+}
+
+} // namespace
+
+void configureNotebooks(const NotebookSettings& settings,
+                        const std::map<std::string, CachedMetadata>& cache) {
+    notebookSettings = settings;
+    cachedNotebooks.clear();
+    for (const auto& entry : cache) {
+        if (entry.second.hasNotebook) {
+            cachedNotebooks[storeKey(entry.first)] = entry.second.notebook;
+        }
+    }
+}
+
+const SourceFile& loadSourceFile(const std::string& filepath) {
+    std::map<std::string, SourceFile>& store = sourceStore();
+    std::string key = storeKey(filepath);
+    std::string extension = fs::path(filepath).extension().string();
+
+    auto it = store.find(key);
+    if (it != store.end()) {
+        return it->second;
+    }
+
+    SourceFile& source = store[key];
+    if (extension == ".md") {
+        loadMarkdown(filepath, source);
+    } else if (extension == ".ipynb") {
+        loadNotebook(filepath, key, source);
+    } else {
+        source.content = readFile(filepath);
+        source.size = source.content.size();
+        source.hash = hashBytes(source.content);
+    }
+
+    return source;
+}
+
+void releaseSourceFile(const std::string& filepath) {
+    auto it = sourceStore().find(storeKey(filepath));
+    if (it == sourceStore().end()) {
+        return;
+    }
+
+    // The title and excerpt own their text; the rest points into content
+    SourceFile& source = it->second;
+    std::pmr::vector<std::string_view>().swap(source.document.lines);
+    std::pmr::vector<MarkdownBlock>().swap(source.document.blocks);
+    std::pmr::vector<MarkdownHeading>().swap(source.document.headings);
+    std::string().swap(source.content);
+    std::string().swap(source.notebookHTML);
+    source.released = true;
+}
+
+const MarkdownDocument& sourceDocument(const std::string& filepath) {
+    const SourceFile& source = loadSourceFile(filepath);
+    assert(!source.released && "markdown rendered again after its page was written");
+    return source.document;
+}
+
+const std::string& renderNotebook(const std::string& filepath) {
+    loadSourceFile(filepath);
+    SourceFile& source = sourceStore()[storeKey(filepath)];
+    assert(!source.released && "notebook rendered again after its page was written");
+    if (source.notebookHTML.empty() && source.size > 0) {
+        convertNotebook(filepath, source);
+    }
+    return source.notebookHTML;
+}
@@ -0,0 +1,281 @@
+#include "escape.h"
+#include <array>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ESCAPE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// AVX2 is compiled per function and only used when the CPU reports it
+#if defined(ESCAPE_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define ESCAPE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Returns the index of the first byte that needs escaping, or length
+typedef size_t (*ScanFunction)(const char* data, size_t length);
+
+struct Scanner {
+    const char* name;
+    ScanFunction html;
+    ScanFunction json;
+};
+
+// Replacement text for each byte; bytes with an empty one are copied as is
+struct Replacement {
+    char text[7];
+    unsigned char length;
+};
+
+constexpr Replacement makeReplacement(const char* text) {
+    Replacement replacement{};
+    while (text[replacement.length]) {
+        replacement.text[replacement.length] = text[replacement.length];
+        replacement.length++;
+    }
+    return replacement;
+}
+
+constexpr std::array<Replacement, 256> buildHTMLReplacements() {
+    std::array<Replacement, 256> table{};
+    table['<'] = makeReplacement("&lt;");
+    table['>'] = makeReplacement("&gt;");
+    table['&'] = makeReplacement("&amp;");
+    table['"'] = makeReplacement("&quot;");
+    table['\''] = makeReplacement("&#39;");
+    return table;
+}
+
+// Control characters without a short form become \u00XX
+constexpr std::array<Replacement, 256> buildJSONReplacements() {
+    const char hex[] = "0123456789abcdef";
+    std::array<Replacement, 256> table{};
+    for (int c = 0; c < 0x20; c++) {
+        char text[7] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF], 0};
+        table[c] = makeReplacement(text);
+    }
+    table['"'] = makeReplacement("\\\"");
+    table['\\'] = makeReplacement("\\\\");
+    table['\b'] = makeReplacement("\\b");
+    table['\f'] = makeReplacement("\\f");
+    table['\n'] = makeReplacement("\\n");
+    table['\r'] = makeReplacement("\\r");
+    table['\t'] = makeReplacement("\\t");
+    return table;
+}
+
+constexpr std::array<Replacement, 256> HTML_REPLACEMENTS = buildHTMLReplacements();
+constexpr std::array<Replacement, 256> JSON_REPLACEMENTS = buildJSONReplacements();
+
+size_t scanHTMLScalar(const char* data, size_t length) {
+    size_t i = 0;
+    while (i < length && HTML_REPLACEMENTS[static_cast<unsigned char>(data[i])].length == 0) {
+        i++;
+    }
+    return i;
+}
+
+size_t scanJSONScalar(const char* data, size_t length) {
+    size_t i = 0;
+    while (i < length && JSON_REPLACEMENTS[static_cast<unsigned char>(data[i])].length == 0) {
+        i++;
+    }
+    return i;
+}
+
+const Scanner SCALAR_SCANNER = {"scalar", scanHTMLScalar, scanJSONScalar};
+
+#ifdef ESCAPE_SSE2
+
+unsigned countTrailingZeros(unsigned mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// < and > differ only in bit 1, & and ' only in bit 0, so three compares
+// cover all five HTML specials
+size_t scanHTMLSSE2(const char* data, size_t length) {
+    const __m128i angle = _mm_set1_epi8(0x3E);
+    const __m128i ampOrApos = _mm_set1_epi8(0x27);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bit1 = _mm_set1_epi8(0x02);
+    const __m128i bit0 = _mm_set1_epi8(0x01);
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(_mm_or_si128(chunk, bit1), angle),
+                         _mm_cmpeq_epi8(_mm_or_si128(chunk, bit0), ampOrApos)),
+            _mm_cmpeq_epi8(chunk, quote));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        if (mask) return i + countTrailingZeros(mask);
+    }
+    return i + scanHTMLScalar(data + i, length - i);
+}
+
+// Control characters are the bytes whose unsigned max with 0x1F is 0x1F
+size_t scanJSONSSE2(const char* data, size_t length) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        if (mask) return i + countTrailingZeros(mask);
+    }
+    return i + scanJSONScalar(data + i, length - i);
+}
+
+const Scanner SSE2_SCANNER = {"sse2", scanHTMLSSE2, scanJSONSSE2};
+
+#endif // ESCAPE_SSE2
+
+#ifdef ESCAPE_AVX2
+
+__attribute__((target("avx2")))
+size_t scanHTMLAVX2(const char* data, size_t length) {
+    const __m256i angle = _mm256_set1_epi8(0x3E);
+    const __m256i ampOrApos = _mm256_set1_epi8(0x27);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i bit1 = _mm256_set1_epi8(0x02);
+    const __m256i bit0 = _mm256_set1_epi8(0x01);
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_or_si256(chunk, bit1), angle),
+                            _mm256_cmpeq_epi8(_mm256_or_si256(chunk, bit0), ampOrApos)),
+            _mm256_cmpeq_epi8(chunk, quote));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+        if (mask) return i + countTrailingZeros(mask);
+    }
+    return i + scanHTMLScalar(data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+size_t scanJSONAVX2(const char* data, size_t length) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash)),
+            _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, control), control));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+        if (mask) return i + countTrailingZeros(mask);
+    }
+    return i + scanJSONScalar(data + i, length - i);
+}
+
+const Scanner AVX2_SCANNER = {"avx2", scanHTMLAVX2, scanJSONAVX2};
+
+bool cpuHasAVX2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // ESCAPE_AVX2
+
+const Scanner* detectScanner() {
+#ifdef ESCAPE_AVX2
+    if (cpuHasAVX2()) return &AVX2_SCANNER;
+#endif
+#ifdef ESCAPE_SSE2
+    return &SSE2_SCANNER;
+#else
+    return &SCALAR_SCANNER;
+#endif
+}
+
+const Scanner*& activeScanner() {
+    static const Scanner* scanner = detectScanner();
+    return scanner;
+}
+
+// Copy clean runs in bulk and escape the bytes between them
+void escapeRuns(std::string_view str, std::string& out, ScanFunction scan,
+                const std::array<Replacement, 256>& replacements) {
+    const char* data = str.data();
+    size_t length = str.length();
+
+    size_t pos = 0;
+    while (pos < length) {
+        size_t clean = scan(data + pos, length - pos);
+        out.append(data + pos, clean);
+        pos += clean;
+        if (pos == length) break;
+
+        const Replacement& replacement = replacements[static_cast<unsigned char>(data[pos])];
+        out.append(replacement.text, replacement.length);
+        pos++;
+    }
+}
+
+} // namespace
+
+void escapeHTML(std::string_view str, std::string& out) {
+    escapeRuns(str, out, activeScanner()->html, HTML_REPLACEMENTS);
+}
+
+std::string escapeHTML(std::string_view str) {
+    std::string escaped;
+    escaped.reserve(str.length() + str.length() / 8);
+    escapeHTML(str, escaped);
+    return escaped;
+}
+
+void escapeJSON(std::string_view str, std::string& out) {
+    escapeRuns(str, out, activeScanner()->json, JSON_REPLACEMENTS);
+}
+
+std::string escapeJSON(std::string_view str) {
+    std::string escaped;
+    escaped.reserve(str.length() + str.length() / 8);
+    escapeJSON(str, escaped);
+    return escaped;
+}
+
+const char* escapeImplementation() {
+    return activeScanner()->name;
+}
+
+bool selectEscapeImplementation(std::string_view name) {
+    if (name == SCALAR_SCANNER.name) {
+        activeScanner() = &SCALAR_SCANNER;
+        return true;
+    }
+#ifdef ESCAPE_SSE2
+    if (name == SSE2_SCANNER.name) {
+        activeScanner() = &SSE2_SCANNER;
+        return true;
+    }
+#endif
+#ifdef ESCAPE_AVX2
+    if (name == AVX2_SCANNER.name && cpuHasAVX2()) {
+        activeScanner() = &AVX2_SCANNER;
+        return true;
+    }
+#endif
+    return false;
+}
@@ -1,4 +1,5 @@
 #include "file_utils.h"
+#include "hash.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -26,3 +27,42 @@ void writeFile(const std::string& filepath, const std::string& content) {
     file.close();
     std::cout << "Generated: " << filepath << std::endl;
 }
+
+HashingFileBuffer::HashingFileBuffer(const std::string& filepath)
+    : file(filepath, std::ios::binary), buffer(64 * 1024), contentHash(FNV_OFFSET), bytesRead(0) {
+    setg(buffer.data(), buffer.data(), buffer.data());
+}
+
+HashingFileBuffer::int_type HashingFileBuffer::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    file.read(buffer.data(), buffer.size());
+    size_t count = static_cast<size_t>(file.gcount());
+    if (count == 0) {
+        return traits_type::eof();
+    }
+
+    contentHash = hashBytes(std::string_view(buffer.data(), count), contentHash);
+    bytesRead += count;
+    setg(buffer.data(), buffer.data(), buffer.data() + count);
+    return traits_type::to_int_type(*gptr());
+}
+
+void HashingFileBuffer::finish() {
+    while (underflow() != traits_type::eof()) {
+        setg(buffer.data(), egptr(), egptr());
+    }
+}
+
+bool hashFile(const std::string& filepath, uint64_t& hash, size_t& size) {
+    HashingFileBuffer file(filepath);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.finish();
+    hash = file.hash();
+    size = file.size();
+    return true;
+}
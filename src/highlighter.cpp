@@ -0,0 +1,423 @@
+#include "highlighter.h"
+#include "escape.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstddef>
+
+namespace {
+
+// Keyword tables are sorted at compile time so lookups can binary search
+
+constexpr std::string_view PYTHON_KEYWORDS[] = {
+    "and", "as", "assert", "async", "await", "break", "class", "continue", "def", "del",
+    "elif", "else", "except", "finally", "for", "from", "global", "if", "import", "in",
+    "is", "lambda", "nonlocal", "not", "or", "pass", "raise", "return", "try", "while",
+    "with", "yield"
+};
+constexpr std::string_view PYTHON_CONSTANTS[] = {"False", "None", "True"};
+constexpr std::string_view PYTHON_BUILTINS[] = {
+    "abs", "all", "any", "bool", "dict", "dir", "enumerate", "filter", "float", "format",
+    "getattr", "hasattr", "int", "isinstance", "len", "list", "map", "max", "min", "open",
+    "print", "range", "repr", "reversed", "round", "set", "setattr", "sorted", "str", "sum",
+    "super", "tuple", "type", "zip"
+};
+
+constexpr std::string_view R_KEYWORDS[] = {
+    "break", "else", "for", "function", "if", "in", "next", "repeat", "return", "while"
+};
+constexpr std::string_view R_CONSTANTS[] = {
+    "FALSE", "Inf", "NA", "NA_character_", "NA_integer_", "NA_real_", "NULL", "NaN", "TRUE"
+};
+constexpr std::string_view R_BUILTINS[] = {
+    "c", "cat", "data.frame", "length", "library", "list", "matrix", "mean", "paste", "print",
+    "rep", "require", "seq", "sum", "vector"
+};
+
+constexpr std::string_view JULIA_KEYWORDS[] = {
+    "abstract", "baremodule", "begin", "break", "catch", "const", "continue", "do", "else",
+    "elseif", "end", "export", "finally", "for", "function", "global", "if", "import", "in",
+    "let", "local", "macro", "module", "mutable", "quote", "return", "struct", "try", "using",
+    "where", "while"
+};
+constexpr std::string_view JULIA_CONSTANTS[] = {"false", "missing", "nothing", "true"};
+constexpr std::string_view JULIA_BUILTINS[] = {
+    "Array", "Dict", "Float64", "Int", "Int64", "String", "Vector", "collect", "length", "map",
+    "print", "println", "size", "sum", "typeof", "zeros"
+};
+
+constexpr std::string_view BASH_KEYWORDS[] = {
+    "case", "do", "done", "elif", "else", "esac", "fi", "for", "function", "if", "in",
+    "local", "return", "select", "then", "until", "while"
+};
+constexpr std::string_view BASH_BUILTINS[] = {
+    "alias", "cd", "echo", "eval", "exec", "exit", "export", "false", "printf", "pwd",
+    "read", "set", "shift", "source", "test", "true", "unset"
+};
+
+constexpr std::string_view CPP_KEYWORDS[] = {
+    "alignas", "auto", "bool", "break", "case", "catch", "char", "class", "const",
+    "constexpr", "continue", "default", "delete", "do", "double", "else", "enum", "explicit",
+    "extern", "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable",
+    "namespace", "new", "noexcept", "operator", "private", "protected", "public", "return",
+    "short", "signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch",
+    "template", "this", "throw", "try", "typedef", "typename", "union", "unsigned", "using",
+    "virtual", "void", "volatile", "while"
+};
+constexpr std::string_view CPP_CONSTANTS[] = {"false", "nullptr", "true"};
+constexpr std::string_view CPP_BUILTINS[] = {
+    "cout", "endl", "map", "size_t", "std", "string", "string_view", "unordered_map", "vector"
+};
+
+constexpr std::string_view JSON_CONSTANTS[] = {"false", "null", "true"};
+
+template <size_t N>
+constexpr bool isSorted(const std::string_view (&words)[N]) {
+    for (size_t i = 1; i < N; i++) {
+        if (!(words[i - 1] < words[i])) return false;
+    }
+    return true;
+}
+
+static_assert(isSorted(PYTHON_KEYWORDS) && isSorted(PYTHON_CONSTANTS) && isSorted(PYTHON_BUILTINS),
+              "python tables must be sorted");
+static_assert(isSorted(R_KEYWORDS) && isSorted(R_CONSTANTS) && isSorted(R_BUILTINS),
+              "r tables must be sorted");
+static_assert(isSorted(JULIA_KEYWORDS) && isSorted(JULIA_CONSTANTS) && isSorted(JULIA_BUILTINS),
+              "julia tables must be sorted");
+static_assert(isSorted(BASH_KEYWORDS) && isSorted(BASH_BUILTINS), "bash tables must be sorted");
+static_assert(isSorted(CPP_KEYWORDS) && isSorted(CPP_CONSTANTS) && isSorted(CPP_BUILTINS),
+              "cpp tables must be sorted");
+static_assert(isSorted(JSON_CONSTANTS), "json tables must be sorted");
+
+struct WordTable {
+    const std::string_view* words;
+    size_t count;
+
+    constexpr WordTable() : words(nullptr), count(0) {}
+    template <size_t N>
+    constexpr WordTable(const std::string_view (&table)[N]) : words(table), count(N) {}
+
+    bool contains(std::string_view word) const {
+        return std::binary_search(words, words + count, word);
+    }
+};
+
+// Everything the tokenizer needs to know about one language
+struct LanguageSpec {
+    std::string_view name;
+    WordTable keywords;
+    WordTable constants;
+    WordTable builtins;
+    std::string_view lineComment;
+    std::string_view blockCommentOpen;
+    std::string_view blockCommentClose;
+    bool tripleQuotes;        // """ and ''' strings
+    bool multilineStrings;    // Plain strings may run past the end of a line
+    bool shellSyntax;         // $variables, # comments only at word start
+    bool preprocessor;        // # at the start of a line is a directive
+    bool dotInIdentifiers;    // R names such as data.frame
+    bool objectKeys;          // A string followed by : is a property
+    bool transposeQuote;      // ' right after a value is an operator
+};
+
+constexpr LanguageSpec LANGUAGES[] = {
+    {"python", PYTHON_KEYWORDS, PYTHON_CONSTANTS, PYTHON_BUILTINS, "#", "", "",
+     true, false, false, false, false, false, false},
+    {"r", R_KEYWORDS, R_CONSTANTS, R_BUILTINS, "#", "", "",
+     false, true, false, false, true, false, false},
+    {"julia", JULIA_KEYWORDS, JULIA_CONSTANTS, JULIA_BUILTINS, "#", "#=", "=#",
+     true, true, false, false, false, false, true},
+    {"bash", BASH_KEYWORDS, WordTable(), BASH_BUILTINS, "#", "", "",
+     false, true, true, false, false, false, false},
+    {"cpp", CPP_KEYWORDS, CPP_CONSTANTS, CPP_BUILTINS, "//", "/*", "*/",
+     false, false, false, true, false, false, false},
+    {"json", WordTable(), JSON_CONSTANTS, WordTable(), "", "", "",
+     false, false, false, false, false, true, false},
+};
+
+// Character classes shared by every language
+enum CharClass : unsigned char {
+    CHAR_IDENT_START = 1,
+    CHAR_IDENT = 2,
+    CHAR_DIGIT = 4,
+    CHAR_OPERATOR = 8,
+    CHAR_PUNCTUATION = 16,
+    CHAR_SPACE = 32
+};
+
+constexpr std::array<unsigned char, 256> buildCharClasses() {
+    std::array<unsigned char, 256> table{};
+    for (int c = 0; c < 256; c++) {
+        unsigned char flags = 0;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80) {
+            flags |= CHAR_IDENT_START | CHAR_IDENT;
+        }
+        if (c >= '0' && c <= '9') {
+            flags |= CHAR_DIGIT | CHAR_IDENT;
+        }
+        if (std::string_view("+-*/%=<>!&|^~?:@").find(static_cast<char>(c)) != std::string_view::npos) {
+            flags |= CHAR_OPERATOR;
+        }
+        if (std::string_view("()[]{},;.").find(static_cast<char>(c)) != std::string_view::npos) {
+            flags |= CHAR_PUNCTUATION;
+        }
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            flags |= CHAR_SPACE;
+        }
+        table[c] = flags;
+    }
+    return table;
+}
+
+constexpr std::array<unsigned char, 256> CHAR_CLASSES = buildCharClasses();
+
+bool hasClass(char c, unsigned char flags) {
+    return (CHAR_CLASSES[static_cast<unsigned char>(c)] & flags) != 0;
+}
+
+void appendToken(const char* type, std::string_view text, std::string& out) {
+    out += "<span class=\"token ";
+    out += type;
+    out += "\">";
+    escapeHTML(text, out);
+    out += "</span>";
+}
+
+const LanguageSpec* findLanguage(std::string_view language) {
+    for (const auto& spec : LANGUAGES) {
+        if (spec.name == language) return &spec;
+    }
+    return nullptr;
+}
+
+// Tokenizes one code sample; each scan* method consumes a token at pos and
+// returns the index after it
+class Tokenizer {
+public:
+    Tokenizer(const LanguageSpec& spec, std::string_view code, std::string& out)
+        : spec(spec), code(code), out(out), pos(0), lineStart(true), noBraceFrom(std::string_view::npos) {}
+
+    void run() {
+        while (pos < code.length()) {
+            char c = code[pos];
+            size_t start = pos;
+
+            if (hasClass(c, CHAR_SPACE)) {
+                while (pos < code.length() && hasClass(code[pos], CHAR_SPACE)) {
+                    if (code[pos] == '\n') lineStart = true;
+                    pos++;
+                }
+                out.append(code.data() + start, pos - start);
+                continue;
+            }
+
+            bool atLineStart = lineStart;
+            lineStart = false;
+
+            if (spec.preprocessor && atLineStart && c == '#') {
+                appendToken("macro", code.substr(start, lineEnd(pos) - start), out);
+                pos = lineEnd(pos);
+            } else if (startsWith(spec.blockCommentOpen)) {
+                size_t close = code.find(spec.blockCommentClose, pos + spec.blockCommentOpen.length());
+                pos = close == std::string_view::npos ? code.length() : close + spec.blockCommentClose.length();
+                appendToken("comment", code.substr(start, pos - start), out);
+            } else if (startsWith(spec.lineComment) &&
+                       (!spec.shellSyntax || start == 0 || hasClass(code[start - 1], CHAR_SPACE))) {
+                pos = lineEnd(pos);
+                appendToken("comment", code.substr(start, pos - start), out);
+            } else if (c == '\'' && spec.transposeQuote && start > 0 &&
+                       (hasClass(code[start - 1], CHAR_IDENT) || code[start - 1] == ')' ||
+                        code[start - 1] == ']' || code[start - 1] == '\'')) {
+                pos++;
+                appendToken("operator", code.substr(start, 1), out);
+            } else if (c == '"' || c == '\'') {
+                scanString(start);
+            } else if (spec.shellSyntax && c == '$') {
+                scanVariable(start);
+            } else if (hasClass(c, CHAR_DIGIT) ||
+                       (c == '.' && pos + 1 < code.length() && hasClass(code[pos + 1], CHAR_DIGIT))) {
+                scanNumber(start);
+            } else if (hasClass(c, CHAR_IDENT_START)) {
+                scanWord(start);
+            } else if (hasClass(c, CHAR_OPERATOR)) {
+                while (pos < code.length() && hasClass(code[pos], CHAR_OPERATOR) &&
+                       !startsWith(spec.lineComment) && !startsWith(spec.blockCommentOpen)) {
+                    pos++;
+                }
+                if (pos == start) pos++;
+                appendToken("operator", code.substr(start, pos - start), out);
+            } else if (hasClass(c, CHAR_PUNCTUATION)) {
+                pos++;
+                appendToken("punctuation", code.substr(start, 1), out);
+            } else {
+                pos++;
+                escapeHTML(code.substr(start, 1), out);
+            }
+        }
+    }
+
+private:
+    bool startsWith(std::string_view prefix) const {
+        return !prefix.empty() && code.compare(pos, prefix.length(), prefix) == 0;
+    }
+
+    size_t lineEnd(size_t from) const {
+        size_t end = code.find('\n', from);
+        return end == std::string_view::npos ? code.length() : end;
+    }
+
+    // A string starting at pos; prefixStart includes a Python prefix like f or rb
+    void scanString(size_t prefixStart) {
+        char quote = code[pos];
+        const char tripleQuote[] = {quote, quote, quote};
+        std::string_view closing(tripleQuote, 3);
+        bool triple = spec.tripleQuotes && code.compare(pos, 3, closing) == 0;
+        bool escapes = !(spec.shellSyntax && quote == '\'');
+
+        pos += triple ? 3 : 1;
+        while (pos < code.length()) {
+            char c = code[pos];
+            if (escapes && c == '\\') {
+                pos += 2;
+                continue;
+            }
+            if (c == quote) {
+                if (!triple) {
+                    pos++;
+                    break;
+                }
+                if (code.compare(pos, 3, closing) == 0) {
+                    pos += 3;
+                    break;
+                }
+            }
+            if (c == '\n' && !triple && !spec.multilineStrings) break;
+            pos++;
+        }
+        pos = std::min(pos, code.length());
+
+        const char* type = "string";
+        if (spec.objectKeys) {
+            size_t next = pos;
+            while (next < code.length() && hasClass(code[next], CHAR_SPACE)) next++;
+            if (next < code.length() && code[next] == ':') type = "property";
+        }
+        appendToken(type, code.substr(prefixStart, pos - prefixStart), out);
+    }
+
+    void scanVariable(size_t start) {
+        pos++;
+        if (pos < code.length() && code[pos] == '{') {
+            // A failed search is not repeated for every later "${", which
+            // would make a block of unclosed ones quadratic
+            size_t close = pos < noBraceFrom ? code.find('}', pos) : std::string_view::npos;
+            if (close == std::string_view::npos) {
+                noBraceFrom = std::min(noBraceFrom, pos);
+                pos = lineEnd(pos);
+            } else {
+                pos = close + 1;
+            }
+        } else if (pos < code.length() && hasClass(code[pos], CHAR_IDENT_START)) {
+            while (pos < code.length() && hasClass(code[pos], CHAR_IDENT)) pos++;
+        } else if (pos < code.length() &&
+                   (hasClass(code[pos], CHAR_DIGIT) ||
+                    std::string_view("@#?$!*-").find(code[pos]) != std::string_view::npos)) {
+            pos++;
+        } else {
+            appendToken("operator", code.substr(start, 1), out);
+            return;
+        }
+        appendToken("variable", code.substr(start, pos - start), out);
+    }
+
+    void scanNumber(size_t start) {
+        while (pos < code.length()) {
+            char c = code[pos];
+            if ((c == '+' || c == '-') && (code[pos - 1] == 'e' || code[pos - 1] == 'E') &&
+                !(code[start] == '0' && start + 1 < code.length() &&
+                  (code[start + 1] == 'x' || code[start + 1] == 'X'))) {
+                pos++;
+            } else if (hasClass(c, CHAR_IDENT) || c == '.') {
+                pos++;
+            } else {
+                break;
+            }
+        }
+        appendToken("number", code.substr(start, pos - start), out);
+    }
+
+    void scanWord(size_t start) {
+        while (pos < code.length() &&
+               (hasClass(code[pos], CHAR_IDENT) || (spec.dotInIdentifiers && code[pos] == '.'))) {
+            pos++;
+        }
+        std::string_view word = code.substr(start, pos - start);
+
+        // String prefixes: f"...", rb'...'
+        if (spec.tripleQuotes && word.length() <= 2 && pos < code.length() &&
+            (code[pos] == '"' || code[pos] == '\'') &&
+            word.find_first_not_of("rRbBfFuU") == std::string_view::npos) {
+            scanString(start);
+            return;
+        }
+
+        if (spec.keywords.contains(word)) {
+            appendToken("keyword", word, out);
+        } else if (spec.constants.contains(word)) {
+            appendToken("boolean", word, out);
+        } else if (spec.builtins.contains(word)) {
+            appendToken("builtin", word, out);
+        } else if (pos < code.length() && code[pos] == '(') {
+            appendToken("function", word, out);
+        } else {
+            escapeHTML(word, out);
+        }
+    }
+
+    const LanguageSpec& spec;
+    std::string_view code;
+    std::string& out;
+    size_t pos;
+    bool lineStart;
+    // No '}' follows this position (found by an earlier failed search)
+    size_t noBraceFrom;
+};
+
+} // namespace
+
+std::string_view highlightLanguage(std::string_view name) {
+    std::string lower(name);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (lower == "python" || lower == "py" || lower == "python3" || lower == "ipython") return "python";
+    if (lower == "r") return "r";
+    if (lower == "julia" || lower == "jl") return "julia";
+    if (lower == "bash" || lower == "sh" || lower == "shell" || lower == "zsh" || lower == "console") return "bash";
+    if (lower == "cpp" || lower == "c++" || lower == "cxx" || lower == "cc" || lower == "c" ||
+        lower == "h" || lower == "hpp") return "cpp";
+    if (lower == "json") return "json";
+    return std::string_view();
+}
+
+void appendCodeBlockStart(std::string_view name, std::string& out) {
+    if (name.empty()) {
+        out += "<pre><code>";
+        return;
+    }
+
+    std::string_view language = highlightLanguage(name);
+    out += "<pre><code class=\"language-";
+    escapeHTML(language.empty() ? name : language, out);
+    out += "\">";
+}
+
+bool highlightCode(std::string_view code, std::string_view language, std::string& out) {
+    const LanguageSpec* spec = findLanguage(language);
+    if (!spec) return false;
+
+    Tokenizer tokenizer(*spec, code, out);
+    tokenizer.run();
+    return true;
+}
@@ -0,0 +1,102 @@
+#include "image_store.h"
+#include "base64.h"
+#include "hash.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Payloads are decoded a block at a time so the image is never in memory
+const size_t BLOCK_SIZE = 64 * 1024;
+
+// Decode base64Data block by block, handing each decoded block to sink.
+// Returns false if the payload is not valid base64.
+template <typename Sink>
+bool decodeBlocks(std::string_view base64Data, Sink sink) {
+    Base64Decoder decoder;
+    std::string decoded;
+    decoded.reserve(BLOCK_SIZE / 4 * 3 + 16);
+
+    for (size_t pos = 0; pos < base64Data.size(); pos += BLOCK_SIZE) {
+        decoded.clear();
+        if (!decoder.update(base64Data.substr(pos, BLOCK_SIZE), decoded)) return false;
+        sink(decoded);
+    }
+    decoded.clear();
+    if (!decoder.finish(decoded)) return false;
+    sink(decoded);
+    return true;
+}
+
+// Distinguishes the temporary files of concurrent writers
+std::atomic<unsigned> tempCounter{0};
+
+std::string hashedName(uint64_t hash, std::string_view extension) {
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return std::string(hex) + std::string(extension);
+}
+
+// Write target under a temporary name and rename it, so a file with a
+// hashed name is always complete
+template <typename Writer>
+void writeAtomically(const fs::path& target, Writer write) {
+    fs::create_directories(target.parent_path());
+    fs::path temp = target;
+    temp += ".tmp" + std::to_string(tempCounter++);
+
+    std::ofstream outFile(temp, std::ios::binary);
+    if (!outFile.is_open()) {
+        throw std::runtime_error("Failed to open file for writing: " + temp.string());
+    }
+    write(outFile);
+    outFile.close();
+    if (!outFile) {
+        fs::remove(temp);
+        throw std::runtime_error("Failed to write file: " + target.string());
+    }
+
+    fs::rename(temp, target);
+}
+
+} // namespace
+
+ImageStore::ImageStore(std::string directory) : root(std::move(directory)) {}
+
+std::string ImageStore::storeBase64(std::string_view base64Data, std::string_view extension) {
+    // First pass: hash the decoded bytes without writing anything
+    uint64_t hash = FNV_OFFSET;
+    if (!decodeBlocks(base64Data, [&](const std::string& block) { hash = hashBytes(block, hash); })) {
+        throw std::runtime_error("Invalid base64 image data");
+    }
+
+    // Second pass, only for a new name: decode again straight into the file
+    std::string filename = hashedName(hash, extension);
+    fs::path target = fs::path(root) / filename;
+    if (!fs::exists(target)) {
+        writeAtomically(target, [&](std::ofstream& outFile) {
+            decodeBlocks(base64Data, [&](const std::string& block) { outFile.write(block.data(), block.size()); });
+        });
+    }
+    return filename;
+}
+
+std::string ImageStore::storeBytes(std::string_view bytes, std::string_view extension) {
+    std::string filename = hashedName(hashBytes(bytes, FNV_OFFSET), extension);
+    fs::path target = fs::path(root) / filename;
+    if (!fs::exists(target)) {
+        writeAtomically(target, [&](std::ofstream& outFile) { outFile.write(bytes.data(), bytes.size()); });
+    }
+    return filename;
+}
+
+void ImageStore::replace(const std::string& filename, std::string_view bytes) {
+    writeAtomically(fs::path(root) / filename,
+                    [&](std::ofstream& outFile) { outFile.write(bytes.data(), bytes.size()); });
+}
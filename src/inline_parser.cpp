@@ -0,0 +1,226 @@
+#include "inline_parser.h"
+
+namespace {
+
+bool isInlineSpecial(char c) {
+    return c == '`' || c == '!' || c == '[' || c == '*' || c == '_';
+}
+
+} // namespace
+
+void InlineRenderer::render(std::string_view text, std::string& out) {
+    source = text;
+    closeBracket = {std::string_view::npos, std::string_view::npos};
+    closeParen = {std::string_view::npos, std::string_view::npos};
+    imageOpen = {std::string_view::npos, std::string_view::npos};
+    failedLinkFrom = failedLinkUntil = failedLinkEnd = std::string_view::npos;
+
+    buffer.clear();
+    delimiters.clear();
+
+    scan(0, text.length());
+    processEmphasis(0);
+
+    // Copy the buffer out, swapping matched delimiter runs for their tags
+    size_t copied = 0;
+    for (const auto& delimiter : delimiters) {
+        if (!delimiter.tag) continue;
+        out.append(buffer, copied, delimiter.position - copied);
+        out += delimiter.tag;
+        copied = delimiter.position + delimiter.length;
+    }
+    out.append(buffer, copied, std::string::npos);
+}
+
+// Searches only move forward, so an earlier answer also covers any later
+// start position that is still before it
+size_t InlineRenderer::findNext(SearchCache& cache, std::string_view pattern, size_t pos) {
+    if (cache.from != std::string_view::npos && pos >= cache.from && pos <= cache.found) {
+        return cache.found;
+    }
+
+    cache.from = pos;
+    cache.found = source.find(pattern, pos);
+    return cache.found;
+}
+
+// Match ![alt](src) at pos; returns the index past the match or npos
+size_t InlineRenderer::findImage(size_t pos, size_t end, size_t& altEnd) {
+    if (pos + 1 >= end || source[pos] != '!' || source[pos + 1] != '[') {
+        return std::string_view::npos;
+    }
+
+    altEnd = findNext(closeBracket, "]", pos + 2);
+    if (altEnd == std::string_view::npos || altEnd + 1 >= end || source[altEnd + 1] != '(') {
+        return std::string_view::npos;
+    }
+
+    size_t srcEnd = findNext(closeParen, ")", altEnd + 2);
+    if (srcEnd == std::string_view::npos || srcEnd >= end || srcEnd == altEnd + 2) {
+        return std::string_view::npos;
+    }
+
+    return srcEnd + 1;
+}
+
+// Match [label](href) at pos. The label runs to the first ], except that
+// images inside it are skipped over so their brackets don't close it early.
+size_t InlineRenderer::findLink(size_t pos, size_t end, size_t& labelEnd) {
+    // A later [ inside a label that already failed walks to the same ]
+    if (end == failedLinkEnd && pos > failedLinkFrom && pos < failedLinkUntil) {
+        return std::string_view::npos;
+    }
+
+    size_t from = pos + 1;
+    size_t altEnd;
+    while (true) {
+        labelEnd = findNext(closeBracket, "]", from);
+        if (labelEnd == std::string_view::npos || labelEnd >= end) {
+            labelEnd = end;
+            break;
+        }
+
+        // Any ![ before this ] has it as its alt end, so one check decides
+        size_t image = findNext(imageOpen, "![", from);
+        if (image >= labelEnd) break;
+
+        size_t imageEnd = findImage(image, end, altEnd);
+        if (imageEnd == std::string_view::npos) break;
+        from = imageEnd;
+    }
+
+    if (labelEnd < end && labelEnd > pos + 1 &&
+        labelEnd + 1 < end && source[labelEnd + 1] == '(') {
+        size_t hrefEnd = findNext(closeParen, ")", labelEnd + 2);
+        if (hrefEnd != std::string_view::npos && hrefEnd < end && hrefEnd > labelEnd + 2) {
+            return hrefEnd + 1;
+        }
+    }
+
+    failedLinkFrom = pos;
+    failedLinkUntil = labelEnd;
+    failedLinkEnd = end;
+    return std::string_view::npos;
+}
+
+void InlineRenderer::scan(size_t begin, size_t end) {
+    bool backticksLeft = true;
+    size_t boundary;
+
+    size_t i = begin;
+    while (i < end) {
+        // Copy plain text up to the next character that could start markup
+        size_t plainEnd = i;
+        while (plainEnd < end && !isInlineSpecial(source[plainEnd])) {
+            plainEnd++;
+        }
+        if (plainEnd > i) {
+            buffer.append(source.data() + i, plainEnd - i);
+            i = plainEnd;
+            continue;
+        }
+
+        char c = source[i];
+
+        if (c == '`' && backticksLeft) {
+            size_t close = source.substr(0, end).find('`', i + 1);
+            if (close == std::string_view::npos) {
+                backticksLeft = false;
+            } else if (close > i + 1) {
+                buffer += "<code>";
+                buffer.append(source.data() + i + 1, close - i - 1);
+                buffer += "</code>";
+                i = close + 1;
+                continue;
+            }
+        } else if (c == '!') {
+            size_t imageEnd = findImage(i, end, boundary);
+            if (imageEnd != std::string_view::npos) {
+                buffer += "<img src=\"";
+                buffer.append(source.data() + boundary + 2, imageEnd - boundary - 3);
+                buffer += "\" alt=\"";
+                buffer.append(source.data() + i + 2, boundary - i - 2);
+                buffer += "\">";
+                i = imageEnd;
+                continue;
+            }
+        } else if (c == '[') {
+            size_t linkEnd = findLink(i, end, boundary);
+            if (linkEnd != std::string_view::npos) {
+                buffer += "<a href=\"";
+                buffer.append(source.data() + boundary + 2, linkEnd - boundary - 3);
+                buffer += "\">";
+
+                // Emphasis inside the label is paired on its own
+                size_t labelDelimiters = delimiters.size();
+                scan(i + 1, boundary);
+                processEmphasis(labelDelimiters);
+                for (size_t k = labelDelimiters; k < delimiters.size(); k++) {
+                    delimiters[k].nested = true;
+                }
+
+                buffer += "</a>";
+                i = linkEnd;
+                continue;
+            }
+        } else if (c == '*' || c == '_') {
+            size_t runEnd = i;
+            while (runEnd < end && source[runEnd] == c) {
+                runEnd++;
+            }
+
+            delimiters.push_back({buffer.size(), runEnd - i, c, nullptr, false});
+            buffer.append(source.data() + i, runEnd - i);
+            i = runEnd;
+            continue;
+        }
+
+        buffer += c;
+        i++;
+    }
+}
+
+// Pair delimiter runs with a stack: a closer matches the nearest earlier run
+// of the same character and length, and unmatched runs in between stay literal
+void InlineRenderer::processEmphasis(size_t first) {
+    openers.clear();
+
+    for (size_t i = first; i < delimiters.size(); i++) {
+        Delimiter& closer = delimiters[i];
+        if (closer.nested || closer.length > 3) continue;
+
+        size_t k = openers.size();
+        while (k > 0) {
+            const Delimiter& candidate = delimiters[openers[k - 1]];
+            if (candidate.marker == closer.marker && candidate.length == closer.length) {
+                break;
+            }
+            k--;
+        }
+
+        if (k == 0) {
+            openers.push_back(i);
+            continue;
+        }
+
+        Delimiter& opener = delimiters[openers[k - 1]];
+        if (closer.length == 1) {
+            opener.tag = "<em>";
+            closer.tag = "</em>";
+        } else if (closer.length == 2) {
+            opener.tag = "<strong>";
+            closer.tag = "</strong>";
+        } else {
+            opener.tag = "<em><strong>";
+            closer.tag = "</strong></em>";
+        }
+        openers.resize(k - 1);
+    }
+}
+
+std::string renderInline(const std::string& text) {
+    InlineRenderer renderer;
+    std::string html;
+    renderer.render(text, html);
+    return html;
+}
@@ -1,458 +1,1250 @@
 #include "../include/jupyter_parser.h"
 #include "../include/markdown_parser.h"
+#include "../include/highlighter.h"
+#include "../include/escape.h"
+#include "../include/cache.h"
+#include "../include/file_utils.h"
+#include "../include/hash.h"
+#include "../include/thread_pool.h"
+#include "../include/base64.h"
 #include <sstream>
 #include <fstream>
 #include <filesystem>
 #include <algorithm>
 #include <cctype>
-#include <regex>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
 
 namespace fs = std::filesystem;
 
-JupyterParser::JupyterParser() {}
-
-std::string JupyterParser::convertToHTML(const std::string& ipynbContent,
-                                          const std::string& notebookPath,
-                                          std::vector<std::string>& extractedImages) {
-    try {
-        // Parse the JSON content
-        json notebook = json::parse(ipynbContent);
-
-        // Parse all cells
-        std::vector<NotebookCell> cells = parseCells(notebook);
-
-        // Detect the programming language from metadata
-        std::string language = "python";
-        if (notebook.contains("metadata")) {
-            language = detectLanguage(notebook["metadata"]);
+namespace {
+
+// Append terminal output with ANSI colour codes (ESC [ digits/semicolons m)
+// removed
+void stripAnsiCodes(std::string_view text, std::pmr::string& out) {
+    size_t pos = 0;
+    while (pos < text.length()) {
+        size_t escape = text.find('\x1b', pos);
+        if (escape == std::string_view::npos) {
+            out.append(text.substr(pos));
+            return;
         }
+        out.append(text.substr(pos, escape - pos));
 
-        // Build HTML output
-        std::stringstream html;
-        html << "<div class=\"jupyter-notebook\">\n";
-
-        int cellNumber = 0;
-        for (const auto& cell : cells) {
-            cellNumber++;
-
-            if (cell.cellType == "markdown") {
-                html << renderMarkdownCell(cell);
-            } else if (cell.cellType == "code") {
-                html << renderCodeCell(cell, cellNumber);
-
-                // Process outputs if they exist
-                if (!cell.outputs.empty()) {
-                    html << renderOutputs(cell.outputs, cell.executionCount, notebookPath, cellNumber, extractedImages);
-                }
+        size_t end = escape + 1;
+        if (end < text.length() && text[end] == '[') {
+            end++;
+            while (end < text.length() && (std::isdigit(static_cast<unsigned char>(text[end])) || text[end] == ';')) {
+                end++;
+            }
+            if (end < text.length() && text[end] == 'm') {
+                pos = end + 1;
+                continue;
             }
-            // Skip raw cells
         }
+        out += '\x1b';
+        pos = escape + 1;
+    }
+}
 
-        html << "</div>\n";
-        return html.str();
+// A batch of cells is rendered once it holds this much source and output
+// text or this many cells, which bounds memory for notebooks of any size.
+// Image payloads are never held by a batch; they are saved as they are read.
+const size_t BATCH_BYTES = 1024 * 1024;
+const size_t BATCH_CELLS = 64;
+
+// Bytes at the end of a notebook searched for its kernel language
+const size_t LANGUAGE_TAIL_BYTES = 64 * 1024;
+
+// Default size up to which an image is put in the page itself
+const size_t DEFAULT_INLINE_IMAGE_BYTES = 4 * 1024;
+
+// Default size above which an output is moved to a side file
+const size_t DEFAULT_OUTPUT_BUDGET = 64 * 1024;
+
+// Text kept inline from an output that was moved out
+const size_t PREVIEW_BYTES = 2048;
+
+// Opens the link to an output moved to a side file; the URL follows
+const std::string_view SIDE_FILE_MARKER = "<details class=\"nb-output-more\" data-src=\"";
+
+// Fetches a side file when its output is expanded; without scripts (or
+// over file://) the link inside the <details> still opens it
+const char* const LAZY_OUTPUT_SCRIPT =
+    "<script>\n"
+    "document.querySelectorAll('details.nb-output-more').forEach(function (details) {\n"
+    "    details.addEventListener('toggle', function () {\n"
+    "        if (!details.open || details.dataset.loaded) return;\n"
+    "        details.dataset.loaded = 'true';\n"
+    "        fetch(details.dataset.src).then(function (response) {\n"
+    "            if (!response.ok) throw new Error(response.statusText);\n"
+    "            return response.text();\n"
+    "        }).then(function (html) {\n"
+    "            var link = details.querySelector('.nb-output-link');\n"
+    "            link.insertAdjacentHTML('afterend', html);\n"
+    "            link.remove();\n"
+    "        }).catch(function () {});\n"
+    "    });\n"
+    "});\n"
+    "</script>\n";
+
+std::string imageTag(std::string_view src, int outputNumber) {
+    std::string tag = "<img src=\"";
+    tag += src;
+    tag += "\" alt=\"Output ";
+    tag += std::to_string(outputNumber);
+    tag += "\" />";
+    return tag;
+}
+
+// Check a base64 payload a piece at a time, the way the image store decodes
+// it, so only a small scratch buffer is decoded into and nothing is kept
+bool validBase64(std::string_view encoded) {
+    const size_t PIECE = 1024;
+    Base64Decoder decoder;
+    std::string scratch;
+    scratch.reserve(PIECE / 4 * 3 + 16);
+    for (size_t pos = 0; pos < encoded.size(); pos += PIECE) {
+        scratch.clear();
+        if (!decoder.update(encoded.substr(pos, PIECE), scratch)) return false;
+    }
+    scratch.clear();
+    return decoder.finish(scratch);
+}
+
+// Kernel language named in the metadata near the end of a notebook, where
+// nbformat's sorted keys put it, or "python" (the default for notebooks
+// without one) if it is not found there
+std::string guessLanguage(std::string_view tail) {
+    const std::string_view SPACE = " \t\r\n";
+    size_t spec = tail.rfind("\"kernelspec\"");
+    if (spec == std::string_view::npos) return "python";
+
+    size_t end = tail.find('}', spec);
+    size_t key = tail.find("\"language\"", spec);
+    if (key == std::string_view::npos || key > end) return "python";
+
+    size_t colon = tail.find_first_not_of(SPACE, key + 10);
+    if (colon == std::string_view::npos || tail[colon] != ':') return "python";
+    size_t open = tail.find_first_not_of(SPACE, colon + 1);
+    if (open == std::string_view::npos || tail[open] != '"') return "python";
+    size_t close = tail.find_first_of("\"\\", open + 1);
+    if (close == std::string_view::npos || tail[close] != '"') return "python";
+
+    return std::string(tail.substr(open + 1, close - open - 1));
+}
 
-    } catch (const json::exception& e) {
-        return "<div class=\"error\">Error parsing notebook: " + std::string(e.what()) + "</div>";
+// guessLanguage for the end of a notebook file
+std::string guessFileLanguage(const std::string& filepath) {
+    std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+    std::string tail;
+    if (file.is_open()) {
+        std::streamoff size = file.tellg();
+        std::streamoff start = std::max<std::streamoff>(0, size - static_cast<std::streamoff>(LANGUAGE_TAIL_BYTES));
+        tail.resize(static_cast<size_t>(size - start));
+        file.seekg(start);
+        file.read(&tail[0], static_cast<std::streamsize>(tail.size()));
+        tail.resize(static_cast<size_t>(file.gcount()));
     }
+    return guessLanguage(tail);
 }
 
-std::vector<NotebookCell> JupyterParser::parseCells(const json& notebook) {
-    std::vector<NotebookCell> cells;
+// "740 bytes", "12 KB", "3.4 MB"
+std::string formatSize(size_t bytes) {
+    char text[32];
+    if (bytes < 1024) {
+        snprintf(text, sizeof(text), "%zu bytes", bytes);
+    } else if (bytes < 1024 * 1024) {
+        snprintf(text, sizeof(text), "%zu KB", bytes / 1024);
+    } else {
+        snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024.0));
+    }
+    return text;
+}
 
-    if (!notebook.contains("cells") || !notebook["cells"].is_array()) {
-        return cells;
+// Pieces of a notebook kept in the cell cache; mixed into every hash so a
+// piece can never be mistaken for another kind
+enum CachedPiece {
+    PIECE_MARKDOWN_CELL = 1,
+    PIECE_CODE_INPUT,
+    PIECE_OUTPUTS,
+    PIECE_IMAGE
+};
+
+} // namespace
+
+// Reads the notebook with json::sax_parse, so no DOM of the whole file is
+// ever built. nbformat sorts keys, which puts a cell's outputs before its
+// source and an output's data before its output_type. An image is written
+// to the image store as soon as its output closes, and a cell is queued
+// once its closing brace is seen. Queued cells are rendered in batches on
+// the shared thread pool, one task per cell, and joined in cell order. The
+// notebook metadata (kernel language) comes after the cells, so code cells
+// read before it are rendered with the language guessed by the caller; the
+// reader reports a wrong guess. The notebook's summary is collected on the
+// same pass.
+class JupyterParser::NotebookReader {
+public:
+    NotebookReader(JupyterParser& parser, const std::string& notebookPath, const std::string& languageGuess,
+                   std::vector<std::string>& extractedImages, std::string& html, NotebookInfo& info)
+        : parser(parser), notebookPath(notebookPath), languageGuess(languageGuess),
+          extractedImages(extractedImages), html(html), info(info), language("python"), languageKnown(false),
+          guessUsed(false), titleFound(false), externalOutputs(false), batchBytes(0), cell(nullptr),
+          outputNumber(0), output(nullptr) {
+        idleRenderers.push_back(&parser);
     }
 
-    std::string notebookLanguage = "python";
-    if (notebook.contains("metadata")) {
-        notebookLanguage = detectLanguage(notebook["metadata"]);
+    // Render the last batch and complete the summary
+    void finish();
+
+    // Some code cell was rendered with a guessed language that the notebook
+    // metadata turned out not to name
+    bool wrongGuess() const { return guessUsed && language != languageGuess; }
+
+    const std::string& error() const { return errorMessage; }
+
+    // Some output was moved to a side file, so the page needs the script
+    // that loads it
+    bool hasExternalOutputs() const { return externalOutputs; }
+
+    // nlohmann::json SAX interface
+    bool null() { return element(); }
+    bool boolean(bool) { return element(); }
+    bool number_integer(json::number_integer_t value) { return number(value); }
+    bool number_unsigned(json::number_unsigned_t value) { return number(value); }
+    bool number_float(json::number_float_t value, const json::string_t&) { return number(value); }
+    bool binary(json::binary_t&) { return element(); }
+    bool string(json::string_t& value);
+    bool start_object(std::size_t);
+    bool key(json::string_t& name);
+    bool end_object();
+    bool start_array(std::size_t);
+    bool end_array();
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e) {
+        errorMessage = e.what();
+        return false;
     }
 
-    for (const auto& cellJson : notebook["cells"]) {
+private:
+    // Containers of interest; everything else is skipped
+    enum Context {
+        CONTEXT_ROOT, CONTEXT_CELLS, CONTEXT_CELL, CONTEXT_OUTPUTS, CONTEXT_OUTPUT,
+        CONTEXT_DATA, CONTEXT_METADATA, CONTEXT_KERNELSPEC, CONTEXT_LINES, CONTEXT_SKIP
+    };
+
+    // What the value after the current key is (or, for a list of lines,
+    // which field the lines are joined into)
+    enum Field {
+        FIELD_NONE, FIELD_CELLS, FIELD_METADATA, FIELD_CELL_TYPE, FIELD_SOURCE,
+        FIELD_EXECUTION_COUNT, FIELD_OUTPUTS, FIELD_OUTPUT_TYPE, FIELD_TEXT, FIELD_DATA,
+        FIELD_MIME_TEXT, FIELD_MIME_IMAGE, FIELD_ENAME, FIELD_EVALUE, FIELD_TRACEBACK,
+        FIELD_KERNELSPEC, FIELD_LANGUAGE
+    };
+
+    struct Frame {
+        Context context;
+        Field field;
+    };
+
+    // Cell read but not rendered yet
+    struct BatchCell {
         NotebookCell cell;
+        bool external;          // Some output is in a side file
+        std::string html;
+
+        explicit BatchCell(std::pmr::memory_resource* resource) : cell(resource), external(false) {}
+    };
+
+    // A scalar or container; one that is an element of an outputs list is
+    // recorded as an invalid output
+    bool element();
+    template <typename T> bool number(T value);
+    void appendLine(Field field, json::string_t& line);
+    void beginCell();
+    void endCell();
+    void beginOutput();
+    void endOutput();
+    void saveImage();
+    void renderBatch();
+
+    // Run task(renderer, i) for every i on the thread pool, each call with a
+    // parser that no other thread is using
+    template <typename Task>
+    void parallelRender(size_t count, Task task);
+    JupyterParser& acquireRenderer();
+    void releaseRenderer(JupyterParser& renderer);
+
+    JupyterParser& parser;
+    const std::string& notebookPath;
+    const std::string& languageGuess;
+    std::vector<std::string>& extractedImages;
+    std::string& html;
+    NotebookInfo& info;
+
+    std::vector<Frame> stack;
+    std::string language;
+    bool languageKnown;
+    bool guessUsed;
+    bool titleFound;
+    bool externalOutputs;
+    std::string errorMessage;
+
+    // Cells waiting to be rendered. Tasks on other threads rewrite their
+    // outputs, so they are allocated from a thread-safe pool.
+    std::pmr::synchronized_pool_resource batchResource;
+    std::deque<BatchCell> batch;
+    size_t batchBytes;
+
+    // The parser itself and helpers created for the other threads
+    std::vector<std::unique_ptr<JupyterParser>> helpers;
+    std::vector<JupyterParser*> idleRenderers;
+    std::mutex rendererMutex;
+
+    // Cell and output being read
+    NotebookCell* cell;
+    int sourceLines;
+    size_t firstLineLength;     // The title is looked for in the first source line
+    int outputNumber;
+    NotebookOutput* output;
+    std::string outputType;
+    int mimePriority;
+    bool hasStreamText;
+    bool hasErrorName;
+    bool hasErrorValue;
+    bool invalidOutput;
+};
+
+namespace {
+
+// Representations in the order they are preferred: images first (PNG, SVG,
+// JPEG), then HTML, then plain text
+const std::string_view MIME_PRIORITY[] = {"image/png", "image/svg+xml", "image/jpeg", "text/html", "text/plain"};
+const int MIME_COUNT = sizeof(MIME_PRIORITY) / sizeof(MIME_PRIORITY[0]);
+
+} // namespace
+
+bool JupyterParser::NotebookReader::element() {
+    Context context = stack.empty() ? CONTEXT_SKIP : stack.back().context;
+    if (context == CONTEXT_OUTPUTS) {
+        beginOutput();
+        output->type = OUTPUT_INVALID;
+        output->text = "output is not an object";
+    }
+    return true;
+}
 
-        // Get cell type
-        if (cellJson.contains("cell_type")) {
-            cell.cellType = cellJson["cell_type"];
-        }
+template <typename T>
+bool JupyterParser::NotebookReader::number(T value) {
+    if (!stack.empty() && stack.back().context != CONTEXT_LINES &&
+        stack.back().field == FIELD_EXECUTION_COUNT) {
+        cell->executionCount = static_cast<int>(value);
+        return true;
+    }
+    return element();
+}
 
-        // Get source content
-        if (cellJson.contains("source")) {
-            cell.source = joinLines(cellJson["source"]);
-        }
+bool JupyterParser::NotebookReader::string(json::string_t& value) {
+    if (stack.empty()) return true;
 
-        // Get language (default to notebook language)
-        cell.language = notebookLanguage;
+    Frame& top = stack.back();
+    if (top.context == CONTEXT_LINES) {
+        appendLine(top.field, value);
+        return true;
+    }
+    if (top.context == CONTEXT_CELLS || top.context == CONTEXT_OUTPUTS) {
+        return element();
+    }
 
-        // Get execution count for code cells
-        cell.executionCount = 0;
-        if (cell.cellType == "code" && cellJson.contains("execution_count")) {
-            if (!cellJson["execution_count"].is_null()) {
-                cell.executionCount = cellJson["execution_count"];
+    switch (top.field) {
+        case FIELD_CELL_TYPE: cell->cellType = value; break;
+        case FIELD_OUTPUT_TYPE: outputType = value; break;
+        case FIELD_LANGUAGE: language = value; break;
+        case FIELD_ENAME: output->errorName = value; hasErrorName = true; break;
+        case FIELD_EVALUE: output->errorValue = value; hasErrorValue = true; break;
+        case FIELD_SOURCE:
+        case FIELD_TEXT:
+        case FIELD_MIME_TEXT:
+        case FIELD_MIME_IMAGE:
+            appendLine(top.field, value);
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+void JupyterParser::NotebookReader::appendLine(Field field, json::string_t& line) {
+    switch (field) {
+        case FIELD_SOURCE:
+            if (sourceLines++ == 0) firstLineLength = line.size();
+            cell->source += line;
+            break;
+        case FIELD_TEXT:
+        case FIELD_MIME_TEXT: output->text += line; break;
+        case FIELD_TRACEBACK: output->traceback.emplace_back(line); break;
+        case FIELD_MIME_IMAGE:
+            // A single payload string is taken over from the reader, not copied
+            if (output->imageData.empty()) {
+                output->imageData = std::move(line);
+            } else {
+                output->imageData += line;
             }
-        }
+            break;
+        default:
+            break;
+    }
+}
+
+bool JupyterParser::NotebookReader::start_object(std::size_t) {
+    Context context = CONTEXT_SKIP;
 
-        // Parse outputs for code cells
-        if (cell.cellType == "code" && cellJson.contains("outputs")) {
-            // We'll store raw output JSON as strings temporarily
-            // They will be parsed when rendering
-            for (const auto& output : cellJson["outputs"]) {
-                cell.outputs.push_back(output.dump());
+    if (stack.empty()) {
+        context = CONTEXT_ROOT;
+    } else {
+        const Frame& top = stack.back();
+        if (top.context == CONTEXT_CELLS) {
+            beginCell();
+            context = CONTEXT_CELL;
+        } else if (top.context == CONTEXT_OUTPUTS) {
+            beginOutput();
+            context = CONTEXT_OUTPUT;
+        } else if (top.context != CONTEXT_LINES) {
+            switch (top.field) {
+                case FIELD_METADATA: context = CONTEXT_METADATA; break;
+                case FIELD_KERNELSPEC: context = CONTEXT_KERNELSPEC; break;
+                case FIELD_DATA: context = CONTEXT_DATA; break;
+                default: break;
             }
         }
+    }
+
+    stack.push_back({context, FIELD_NONE});
+    return true;
+}
 
-        cells.push_back(cell);
+bool JupyterParser::NotebookReader::key(json::string_t& name) {
+    Frame& top = stack.back();
+    Field field = FIELD_NONE;
+
+    switch (top.context) {
+        case CONTEXT_ROOT:
+            if (name == "cells") field = FIELD_CELLS;
+            else if (name == "metadata") field = FIELD_METADATA;
+            break;
+        case CONTEXT_CELL:
+            if (name == "cell_type") field = FIELD_CELL_TYPE;
+            else if (name == "source") field = FIELD_SOURCE;
+            else if (name == "execution_count") field = FIELD_EXECUTION_COUNT;
+            else if (name == "outputs") field = FIELD_OUTPUTS;
+            break;
+        case CONTEXT_OUTPUT:
+            if (name == "output_type") field = FIELD_OUTPUT_TYPE;
+            else if (name == "text") { field = FIELD_TEXT; hasStreamText = true; }
+            else if (name == "data") field = FIELD_DATA;
+            else if (name == "ename") field = FIELD_ENAME;
+            else if (name == "evalue") field = FIELD_EVALUE;
+            else if (name == "traceback") field = FIELD_TRACEBACK;
+            break;
+        case CONTEXT_DATA:
+            // Keep only the most preferred representation seen so far
+            for (int priority = 0; priority < mimePriority; priority++) {
+                if (name == MIME_PRIORITY[priority]) {
+                    mimePriority = priority;
+                    output->mimeType = MIME_PRIORITY[priority];
+                    output->text.clear();
+                    std::string().swap(output->imageData);
+                    bool base64 = output->mimeType == "image/png" || output->mimeType == "image/jpeg";
+                    field = base64 ? FIELD_MIME_IMAGE : FIELD_MIME_TEXT;
+                    break;
+                }
+            }
+            break;
+        case CONTEXT_METADATA:
+            if (name == "kernelspec") field = FIELD_KERNELSPEC;
+            break;
+        case CONTEXT_KERNELSPEC:
+            if (name == "language") field = FIELD_LANGUAGE;
+            break;
+        default:
+            break;
     }
 
-    return cells;
+    top.field = field;
+    return true;
 }
 
-std::string JupyterParser::renderMarkdownCell(const NotebookCell& cell) {
-    // Use the existing MarkdownParser to convert markdown to HTML
-    MarkdownParser mdParser;
-    std::string htmlContent = mdParser.convertToHTML(cell.source);
+bool JupyterParser::NotebookReader::end_object() {
+    Context context = stack.back().context;
+    stack.pop_back();
+
+    if (context == CONTEXT_CELL) {
+        endCell();
+    } else if (context == CONTEXT_OUTPUT) {
+        endOutput();
+    } else if (context == CONTEXT_METADATA) {
+        languageKnown = true;
+    }
+    return true;
+}
 
-    std::stringstream html;
-    html << "  <div class=\"nb-cell nb-markdown-cell\">\n";
-    html << "    " << htmlContent << "\n";
-    html << "  </div>\n";
+bool JupyterParser::NotebookReader::start_array(std::size_t) {
+    Context context = CONTEXT_SKIP;
+    Field field = FIELD_NONE;
+
+    if (!stack.empty()) {
+        const Frame& top = stack.back();
+        if (top.context == CONTEXT_CELLS || top.context == CONTEXT_OUTPUTS) {
+            element();
+        } else if (top.context != CONTEXT_LINES) {
+            switch (top.field) {
+                case FIELD_CELLS:
+                    context = CONTEXT_CELLS;
+                    break;
+                case FIELD_OUTPUTS:
+                    // Outputs of markdown and raw cells are never rendered
+                    if (cell->cellType.empty() || cell->cellType == "code") {
+                        context = CONTEXT_OUTPUTS;
+                    }
+                    break;
+                case FIELD_SOURCE:
+                case FIELD_TEXT:
+                case FIELD_MIME_TEXT:
+                case FIELD_MIME_IMAGE:
+                case FIELD_TRACEBACK:
+                    context = CONTEXT_LINES;
+                    field = top.field;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
 
-    return html.str();
+    stack.push_back({context, field});
+    return true;
 }
 
-std::string JupyterParser::renderCodeCell(const NotebookCell& cell, int cellNumber) {
-    std::stringstream html;
-    std::string languageClass = getPrismLanguageClass(cell.language);
+bool JupyterParser::NotebookReader::end_array() {
+    stack.pop_back();
+    return true;
+}
 
-    html << "  <div class=\"nb-cell nb-code-cell\">\n";
-    html << "    <div class=\"nb-input\">\n";
+void JupyterParser::NotebookReader::beginCell() {
+    info.cellCount++;
+    sourceLines = 0;
+    firstLineLength = 0;
+    outputNumber = 0;
+    cell = &batch.emplace_back(&batchResource).cell;
+}
 
-    // Add input prompt with execution count
-    if (cell.executionCount > 0) {
-        html << "      <div class=\"nb-input-prompt\">In [" << cell.executionCount << "]:</div>\n";
-    } else {
-        html << "      <div class=\"nb-input-prompt\">In [ ]:</div>\n";
+void JupyterParser::NotebookReader::endCell() {
+    if (cell->cellType == "markdown") {
+        // Title from the first markdown cell opening with a "# " heading
+        std::string_view firstLine = std::string_view(cell->source).substr(0, firstLineLength);
+        if (!titleFound && firstLine.substr(0, 2) == "# ") {
+            info.title = firstLine.substr(2);
+            if (!info.title.empty() && info.title.back() == '\n') {
+                info.title.pop_back();
+            }
+            titleFound = true;
+        }
+    } else if (cell->cellType == "code") {
+        cell->language = languageKnown ? language : languageGuess;
+        guessUsed = guessUsed || !languageKnown;
     }
 
-    // Add code with Prism.js syntax highlighting
-    html << "      <pre><code class=\"" << languageClass << "\">";
-    html << escapeHTML(cell.source);
-    html << "</code></pre>\n";
-    html << "    </div>\n";
+    batchBytes += cell->source.size();
+    for (const auto& cellOutput : cell->outputs) {
+        batchBytes += cellOutput.text.size();
+        for (const auto& line : cellOutput.traceback) {
+            batchBytes += line.size();
+        }
+    }
+
+    output = nullptr;
+    cell = nullptr;
+    if (batchBytes >= BATCH_BYTES || batch.size() >= BATCH_CELLS) {
+        renderBatch();
+    }
+}
 
-    return html.str();
+void JupyterParser::NotebookReader::beginOutput() {
+    info.outputCount++;
+    outputNumber++;
+    output = &cell->outputs.emplace_back(&batchResource);
+    outputType.clear();
+    mimePriority = MIME_COUNT;
+    hasStreamText = false;
+    hasErrorName = false;
+    hasErrorValue = false;
 }
 
-std::string JupyterParser::renderOutputs(const std::vector<std::string>& outputs, int executionCount,
-                                          const std::string& notebookPath, int cellNumber,
-                                          std::vector<std::string>& extractedImages) {
-    if (outputs.empty()) {
-        return "";
+void JupyterParser::NotebookReader::endOutput() {
+    info.outputBytes += output->text.size() + output->imageData.size();
+    for (const auto& line : output->traceback) {
+        info.outputBytes += line.size();
+    }
+    if (output->mimeType.substr(0, 6) == "image/") {
+        info.imageCount++;
     }
 
-    std::stringstream html;
+    if (outputType == "stream") {
+        output->type = OUTPUT_STREAM;
+        output->mimeType = hasStreamText ? "text/plain" : "";
+    } else if (outputType == "display_data" || outputType == "execute_result") {
+        output->type = outputType == "display_data" ? OUTPUT_DISPLAY_DATA : OUTPUT_EXECUTE_RESULT;
+    } else if (outputType == "error") {
+        output->type = OUTPUT_ERROR;
+        output->hasError = hasErrorName && hasErrorValue;
+    }
 
-    int outputNumber = 0;
-    for (const auto& outputStr : outputs) {
-        outputNumber++;
+    saveImage();
+    std::string().swap(output->imageData);
+}
 
-        try {
-            json output = json::parse(outputStr);
-            std::string outputType = output.value("output_type", "");
+// The output's HTML holds the image's file name, so the image is written
+// before its cell is queued and the batch never holds its payload. SVGs are
+// text and only leave the page when they are large.
+void JupyterParser::NotebookReader::saveImage() {
+    if (output->type != OUTPUT_DISPLAY_DATA && output->type != OUTPUT_EXECUTE_RESULT) return;
+
+    if (!output->imageData.empty()) {
+        output->text = parser.extractBase64Image(output->imageData, output->mimeType, notebookPath, outputNumber,
+                                                 extractedImages);
+    } else if (output->mimeType == "image/svg+xml" && output->text.size() > parser.inlineImageBytes) {
+        output->text = parser.extractSvgImage(output->text, notebookPath, outputNumber, extractedImages);
+    }
+}
 
-            if (outputType == "stream") {
-                html << "    <div class=\"nb-output\">\n";
-                if (executionCount > 0) {
-                    html << "      <div class=\"nb-output-prompt\"></div>\n";
-                }
-                html << parseStreamOutput(output);
-                html << "    </div>\n";
-            } else if (outputType == "display_data" || outputType == "execute_result") {
-                html << "    <div class=\"nb-output\">\n";
+void JupyterParser::NotebookReader::renderBatch() {
+    if (batch.empty()) return;
 
-                // Add output prompt for execute_result
-                if (outputType == "execute_result" && executionCount > 0) {
-                    html << "      <div class=\"nb-output-prompt\">Out[" << executionCount << "]:</div>\n";
-                }
+    parallelRender(batch.size(), [&](JupyterParser& renderer, size_t index) {
+        BatchCell& batchCell = batch[index];
+        batchCell.external = renderer.renderCell(batchCell.cell, notebookPath, batchCell.html);
+    });
 
-                // Parse the output data
-                if (outputType == "display_data") {
-                    html << parseDisplayData(output, notebookPath, cellNumber, outputNumber, extractedImages);
-                } else {
-                    html << parseExecuteResult(output, notebookPath, cellNumber, outputNumber, extractedImages);
-                }
+    for (auto& batchCell : batch) {
+        html += batchCell.html;
+        externalOutputs = externalOutputs || batchCell.external;
+    }
 
-                html << "    </div>\n";
-            } else if (outputType == "error") {
-                html << "    <div class=\"nb-output\">\n";
-                html << parseErrorOutput(output);
-                html << "    </div>\n";
-            }
+    // Cache entries are only touched here, never by the tasks
+    parser.applyCacheUpdates();
+    for (auto& helper : helpers) {
+        helper->applyCacheUpdates();
+    }
 
-        } catch (const json::exception& e) {
-            html << "    <div class=\"nb-output-error\">Error parsing output: " << e.what() << "</div>\n";
+    batch.clear();
+    batchBytes = 0;
+}
+
+template <typename Task>
+void JupyterParser::NotebookReader::parallelRender(size_t count, Task task) {
+    ThreadPool::shared().parallelFor(count, [&](size_t index) {
+        JupyterParser& renderer = acquireRenderer();
+        try {
+            task(renderer, index);
+        } catch (...) {
+            releaseRenderer(renderer);
+            throw;
         }
+        releaseRenderer(renderer);
+    });
+}
+
+JupyterParser& JupyterParser::NotebookReader::acquireRenderer() {
+    std::lock_guard<std::mutex> lock(rendererMutex);
+    if (idleRenderers.empty()) {
+        helpers.push_back(parser.createHelper());
+        return *helpers.back();
     }
+    JupyterParser* renderer = idleRenderers.back();
+    idleRenderers.pop_back();
+    return *renderer;
+}
 
-    html << "  </div>\n";  // Close nb-code-cell
-    return html.str();
+void JupyterParser::NotebookReader::releaseRenderer(JupyterParser& renderer) {
+    renderer.arena.reset();
+    std::lock_guard<std::mutex> lock(rendererMutex);
+    idleRenderers.push_back(&renderer);
 }
 
-std::string JupyterParser::parseStreamOutput(const json& output) {
-    std::stringstream html;
+void JupyterParser::NotebookReader::finish() {
+    renderBatch();
+    info.language = language;
+}
 
-    if (output.contains("text")) {
-        std::string text = joinLines(output["text"]);
-        html << "      <pre>" << escapeHTML(text) << "</pre>\n";
-    }
+JupyterParser::JupyterParser(const std::string& imageDirectory)
+    : imageStore(imageDirectory), cellCache(nullptr), outputBudget(DEFAULT_OUTPUT_BUDGET),
+      inlineImageBytes(DEFAULT_INLINE_IMAGE_BYTES) {}
 
-    return html.str();
+void JupyterParser::setCellCache(std::unordered_map<size_t, CachedBlock>* cache) {
+    cellCache = cache;
 }
 
-std::string JupyterParser::parseDisplayData(const json& output,
-                                             const std::string& notebookPath,
-                                             int cellNumber, int outputNumber,
-                                             std::vector<std::string>& extractedImages) {
-    std::stringstream html;
+void JupyterParser::setOutputBudget(size_t bytes) {
+    outputBudget = bytes;
+}
 
-    if (!output.contains("data")) {
-        return html.str();
-    }
+void JupyterParser::setInlineImageLimit(size_t bytes) {
+    inlineImageBytes = bytes;
+}
 
-    const json& data = output["data"];
+std::unique_ptr<JupyterParser> JupyterParser::createHelper() const {
+    auto helper = std::make_unique<JupyterParser>(imageStore.directory());
+    helper->setCellCache(cellCache);
+    helper->setOutputBudget(outputBudget);
+    helper->setInlineImageLimit(inlineImageBytes);
+    return helper;
+}
 
-    // Check for images first (PNG, SVG, JPEG)
-    if (data.contains("image/png")) {
-        std::string imgHtml = extractBase64Image(data["image/png"], "image/png",
-                                                  notebookPath, cellNumber, outputNumber,
-                                                  extractedImages);
-        html << "      " << imgHtml << "\n";
-    } else if (data.contains("image/svg+xml")) {
-        // For SVG, we can embed it directly
-        std::string svgContent = joinLines(data["image/svg+xml"]);
-        html << "      " << svgContent << "\n";
-    } else if (data.contains("image/jpeg")) {
-        std::string imgHtml = extractBase64Image(data["image/jpeg"], "image/jpeg",
-                                                  notebookPath, cellNumber, outputNumber,
-                                                  extractedImages);
-        html << "      " << imgHtml << "\n";
-    }
-    // Check for HTML output
-    else if (data.contains("text/html")) {
-        std::string htmlContent = joinLines(data["text/html"]);
-        html << "      <div class=\"nb-html-output\">" << htmlContent << "</div>\n";
+template <typename Render>
+void JupyterParser::renderCached(const CacheKey& key, std::string& out, Render render) {
+    renderCached(key, out, render, [](const std::string&) { return true; });
+}
+
+template <typename Render, typename Usable>
+void JupyterParser::renderCached(const CacheKey& key, std::string& out, Render render, Usable usable) {
+    if (!cellCache) {
+        render(out);
+        return;
     }
-    // Check for plain text
-    else if (data.contains("text/plain")) {
-        std::string text = joinLines(data["text/plain"]);
-        html << "      <pre>" << escapeHTML(text) << "</pre>\n";
+
+    auto cached = cellCache->find(key.hash);
+    if (cached != cellCache->end() && cached->second.check == key.check && usable(cached->second.html)) {
+        out += cached->second.html;
+        cacheHits.push_back(&cached->second);
+        return;
     }
 
-    return html.str();
+    size_t start = out.size();
+    render(out);
+    cacheAdditions.emplace_back(key, out.substr(start));
 }
 
-std::string JupyterParser::parseExecuteResult(const json& output,
-                                                const std::string& notebookPath,
-                                                int cellNumber, int outputNumber,
-                                                std::vector<std::string>& extractedImages) {
-    // Execute result has the same structure as display_data
-    return parseDisplayData(output, notebookPath, cellNumber, outputNumber, extractedImages);
+void JupyterParser::applyCacheUpdates() {
+    for (CachedBlock* hit : cacheHits) {
+        hit->used = true;
+    }
+    for (auto& addition : cacheAdditions) {
+        CachedBlock& entry = (*cellCache)[addition.first.hash];
+        entry.html = std::move(addition.second);
+        entry.check = addition.first.check;
+        entry.used = true;
+    }
+    cacheHits.clear();
+    cacheAdditions.clear();
 }
 
-std::string JupyterParser::parseErrorOutput(const json& output) {
-    std::stringstream html;
+bool JupyterParser::renderCell(NotebookCell& cell, const std::string& notebookPath, std::string& out) {
+    bool external = false;
+    if (cell.cellType == "markdown") {
+        renderCached(markdownCellKey(cell), out, [&](std::string& html) { renderMarkdownCell(cell, html); });
+    } else if (cell.cellType == "code") {
+        renderCached(codeInputKey(cell), out, [&](std::string& html) { renderCodeCell(cell, html); });
+
+        // Process outputs if they exist. The cache is looked up first, so a
+        // hit neither renders nor writes the side files again; it is only
+        // used while the side files it links to are still there.
+        if (!cell.outputs.empty()) {
+            bool anyOverBudget = false;
+            for (const auto& output : cell.outputs) {
+                anyOverBudget = anyOverBudget || overBudget(output);
+            }
+            size_t start = out.size();
+            renderCached(
+                outputsKey(cell, notebookPath), out,
+                [&](std::string& html) {
+                    for (auto& output : cell.outputs) {
+                        externalizeOutput(output, notebookPath);
+                    }
+                    renderOutputs(cell, html);
+                },
+                [&](const std::string& html) { return !anyOverBudget || sideFilesPresent(html); });
+            external = anyOverBudget &&
+                       std::string_view(out).substr(start).find(SIDE_FILE_MARKER) != std::string_view::npos;
+        }
+    }
+    // Skip raw cells
+    return external;
+}
 
-    if (output.contains("ename") && output.contains("evalue")) {
-        std::string ename = output["ename"];
-        std::string evalue = output["evalue"];
+CacheKey JupyterParser::markdownCellKey(const NotebookCell& cell) {
+    CacheKey key(PIECE_MARKDOWN_CELL);
+    key.mixText(cell.source);
+    return key;
+}
 
-        html << "      <div class=\"nb-output-error\">";
-        html << "<strong>" << escapeHTML(ename) << ":</strong> " << escapeHTML(evalue);
+CacheKey JupyterParser::codeInputKey(const NotebookCell& cell) {
+    CacheKey key(PIECE_CODE_INPUT);
+    key.mixText(cell.source);
+    key.mixText(cell.language);
+    key.mix(cell.executionCount);
+    return key;
+}
 
-        // Add traceback if available
-        if (output.contains("traceback")) {
-            html << "\n\n";
-            for (const auto& line : output["traceback"]) {
-                std::string traceLine = line;
-                // Remove ANSI escape codes
-                traceLine = std::regex_replace(traceLine, std::regex("\x1b\\[[0-9;]*m"), "");
-                html << escapeHTML(traceLine) << "\n";
-            }
+// Images are on disk by now and their <img> tags are in text. Outputs over
+// the budget are not moved out yet; what that makes of them depends on the
+// budget and, for the side file's link, on the notebook's location.
+CacheKey JupyterParser::outputsKey(const NotebookCell& cell, const std::string& notebookPath) {
+    CacheKey key(PIECE_OUTPUTS);
+    key.mix(cell.executionCount);
+    key.mix(outputBudget);
+    key.mixText(imageURL(notebookPath));
+    for (const auto& output : cell.outputs) {
+        key.mix(output.type);
+        key.mixText(output.mimeType);
+        key.mixText(output.text);
+        key.mix(output.hasError);
+        key.mixText(output.errorName);
+        key.mixText(output.errorValue);
+        key.mix(output.traceback.size());
+        for (const auto& line : output.traceback) {
+            key.mixText(line);
         }
+    }
+    return key;
+}
 
-        html << "</div>\n";
+template <typename Input>
+std::string JupyterParser::convert(Input&& input, const std::string& notebookPath, std::string& language,
+                                   std::vector<std::string>& extractedImages, NotebookInfo& info) {
+    info = NotebookInfo();
+
+    std::string html = "<div class=\"jupyter-notebook\">\n";
+    {
+        NotebookReader reader(*this, notebookPath, language, extractedImages, html, info);
+        if (!json::sax_parse(std::forward<Input>(input), &reader)) {
+            arena.reset();
+            info.title.clear();
+            return "<div class=\"error\">Error parsing notebook: " + reader.error() + "</div>";
+        }
+        reader.finish();
+        if (reader.wrongGuess()) {
+            arena.reset();
+            language = info.language;
+            return std::string();
+        }
+        if (reader.hasExternalOutputs()) {
+            html += LAZY_OUTPUT_SCRIPT;
+        }
     }
+    arena.reset();
 
-    return html.str();
+    html += "</div>\n";
+    return html;
 }
 
-std::string JupyterParser::extractBase64Image(const std::string& base64Data,
-                                                const std::string& mimeType,
-                                                const std::string& notebookPath,
-                                                int cellNumber, int outputNumber,
-                                                std::vector<std::string>& extractedImages) {
-    try {
-        // Determine file extension
-        std::string extension = ".png";
-        if (mimeType == "image/jpeg") {
-            extension = ".jpg";
-        } else if (mimeType == "image/svg+xml") {
-            extension = ".svg";
+// Code cells come before the notebook metadata, so they are rendered with
+// the language guessed from the end of the notebook. If the guess was wrong
+// (the metadata is not at the end) the notebook is read again.
+std::string JupyterParser::convertToHTML(const std::string& ipynbContent,
+                                          const std::string& notebookPath,
+                                          std::vector<std::string>& extractedImages,
+                                          NotebookInfo& info) {
+    size_t tailLength = std::min(ipynbContent.size(), LANGUAGE_TAIL_BYTES);
+    std::string language = guessLanguage(std::string_view(ipynbContent).substr(ipynbContent.size() - tailLength));
+    std::string guess;
+    std::string html;
+    size_t imageCount = extractedImages.size();
+    do {
+        guess = language;
+        extractedImages.resize(imageCount);
+        html = convert(ipynbContent, notebookPath, language, extractedImages, info);
+    } while (language != guess);
+
+    info.sourceHash = hashString(ipynbContent);
+    return html;
+}
+
+std::string JupyterParser::convertFile(const std::string& notebookPath,
+                                       std::vector<std::string>& extractedImages,
+                                       NotebookInfo& info) {
+    std::string language = guessFileLanguage(notebookPath);
+    std::string guess;
+    std::string html;
+    size_t imageCount = extractedImages.size();
+    do {
+        HashingFileBuffer file(notebookPath);
+        if (!file.is_open()) {
+            info = NotebookInfo();
+            return "<div class=\"error\">Error parsing notebook: could not open " + notebookPath + "</div>";
         }
 
-        // Generate filename based on notebook name and cell/output numbers
-        fs::path nbPath(notebookPath);
-        std::string stem = nbPath.stem().string();
-        std::string filename = stem + "_cell" + std::to_string(cellNumber) +
-                                "_out" + std::to_string(outputNumber) + extension;
+        guess = language;
+        extractedImages.resize(imageCount);
+        std::istream in(&file);
+        html = convert(in, notebookPath, language, extractedImages, info);
+        file.finish();
+        info.sourceHash = static_cast<size_t>(file.hash());
+    } while (language != guess);
 
-        // Create output directory if it doesn't exist
-        fs::path imagesDir = "content/images/notebooks";
-        if (!fs::exists(imagesDir)) {
-            fs::create_directories(imagesDir);
-        }
+    return html;
+}
 
-        // Full path for the image
-        fs::path imagePath = imagesDir / filename;
+void JupyterParser::renderMarkdownCell(const NotebookCell& cell, std::string& out) {
+    // One MarkdownParser for every cell keeps its arena and buffers warm
+    out += "  <div class=\"nb-cell nb-markdown-cell\">\n";
+    out += "    ";
+    markdownParser.convertToHTML(cell.source, out);
+    out += "\n";
+    out += "  </div>\n";
+}
 
-        // Decode base64 and save image
-        std::vector<unsigned char> imageData;
-        std::string decoded = base64Decode(base64Data);
-        imageData.assign(decoded.begin(), decoded.end());
+void JupyterParser::renderCodeCell(const NotebookCell& cell, std::string& out) {
+    out += "  <div class=\"nb-cell nb-code-cell\">\n";
+    out += "    <div class=\"nb-input\">\n";
 
-        saveImage(imageData, imagePath.string());
+    // Add input prompt with execution count
+    if (cell.executionCount > 0) {
+        out += "      <div class=\"nb-input-prompt\">In [";
+        out += std::to_string(cell.executionCount);
+        out += "]:</div>\n";
+    } else {
+        out += "      <div class=\"nb-input-prompt\">In [ ]:</div>\n";
+    }
 
-        // Add to extracted images list
-        extractedImages.push_back(imagePath.string());
+    // Code highlighted at build time, with the same classes as markdown
+    // code blocks (which Prism.js also reads in client-side mode)
+    out += "      ";
+    appendCodeBlockStart(cell.language, out);
+    if (!highlightCode(cell.source, highlightLanguage(cell.language), out)) {
+        escapeHTML(cell.source, out);
+    }
+    out += "</code></pre>\n";
+    out += "    </div>\n";
+}
 
-        // Calculate correct relative path based on notebook location
-        // Count depth by looking for how many directories deep the notebook is in content/blog/
-        std::string pathStr = nbPath.string();
-        int depth = 1;  // Default for content/blog/notebook.ipynb
+void JupyterParser::renderOutputs(const NotebookCell& cell, std::string& out) {
+    for (const auto& output : cell.outputs) {
+        switch (output.type) {
+            case OUTPUT_STREAM:
+                out += "    <div class=\"nb-output\">\n";
+                if (cell.executionCount > 0) {
+                    out += "      <div class=\"nb-output-prompt\"></div>\n";
+                }
+                renderOutputBody(output, out);
+                out += "    </div>\n";
+                break;
 
-        // Count slashes after "content/blog/" or "blog/"
-        size_t blogPos = pathStr.find("content/blog/");
-        if (blogPos == std::string::npos) {
-            blogPos = pathStr.find("blog/");
-        }
+            case OUTPUT_DISPLAY_DATA:
+            case OUTPUT_EXECUTE_RESULT:
+                out += "    <div class=\"nb-output\">\n";
 
-        if (blogPos != std::string::npos) {
-            std::string afterBlog = pathStr.substr(blogPos + (pathStr.find("content/blog/") != std::string::npos ? 13 : 5));
-            depth = 1;  // Start at 1 for files directly in blog/
-            for (char c : afterBlog) {
-                if (c == '/' || c == '\\') depth++;
-            }
-        }
+                // Add output prompt for execute_result
+                if (output.type == OUTPUT_EXECUTE_RESULT && cell.executionCount > 0) {
+                    out += "      <div class=\"nb-output-prompt\">Out[";
+                    out += std::to_string(cell.executionCount);
+                    out += "]:</div>\n";
+                }
 
-        // Build relative path (e.g., "../images/" or "../../images/" or "../../../images/")
-        std::string relativePath;
-        for (int i = 0; i < depth; i++) {
-            relativePath += "../";
+                // Execute results have the same structure as display data
+                renderOutputBody(output, out);
+                out += "    </div>\n";
+                break;
+
+            case OUTPUT_ERROR:
+                out += "    <div class=\"nb-output\">\n";
+                renderOutputBody(output, out);
+                out += "    </div>\n";
+                break;
+
+            case OUTPUT_INVALID:
+                out += "    <div class=\"nb-output-error\">Error parsing output: ";
+                out += output.text;
+                out += "</div>\n";
+                break;
+
+            case OUTPUT_OTHER:
+                break;
         }
-        relativePath += "images/notebooks/";
+    }
 
-        // Return HTML img tag with relative path
-        return "<img src=\"" + relativePath + filename + "\" alt=\"Output " +
-               std::to_string(outputNumber) + "\" />";
+    out += "  </div>\n";  // Close nb-code-cell
+}
 
-    } catch (const std::exception& e) {
-        return "<div class=\"error\">Error extracting image: " + std::string(e.what()) + "</div>";
-    }
+void JupyterParser::renderStreamOutput(const NotebookOutput& output, std::string& out) {
+    if (output.mimeType.empty()) return;
+
+    out += "      <pre>";
+    escapeHTML(output.text, out);
+    out += "</pre>\n";
 }
 
-std::string JupyterParser::saveImage(const std::vector<unsigned char>& imageData,
-                                      const std::string& outputPath) {
-    std::ofstream outFile(outputPath, std::ios::binary);
-    if (!outFile.is_open()) {
-        throw std::runtime_error("Failed to open file for writing: " + outputPath);
+void JupyterParser::renderDisplayData(const NotebookOutput& output, std::string& out) {
+    if (output.mimeType == "image/png" || output.mimeType == "image/jpeg") {
+        // Saved while the notebook was read; text holds the <img> tag
+        out += "      ";
+        out += output.text;
+        out += "\n";
+    } else if (output.mimeType == "image/svg+xml") {
+        // Small SVGs are embedded directly; a large one was saved and text
+        // holds its <img> tag
+        out += "      ";
+        out += output.text;
+        out += "\n";
+    } else if (output.mimeType == "text/html") {
+        out += "      <div class=\"nb-html-output\">";
+        out += output.text;
+        out += "</div>\n";
+    } else if (output.mimeType == "text/plain") {
+        out += "      <pre>";
+        escapeHTML(output.text, out);
+        out += "</pre>\n";
     }
+}
 
-    outFile.write(reinterpret_cast<const char*>(imageData.data()), imageData.size());
-    outFile.close();
+void JupyterParser::renderErrorOutput(const NotebookOutput& output, std::string& out) {
+    if (!output.hasError) return;
+
+    out += "      <div class=\"nb-output-error\">";
+    out += "<strong>";
+    escapeHTML(output.errorName, out);
+    out += ":</strong> ";
+    escapeHTML(output.errorValue, out);
+
+    // Add traceback if available
+    if (!output.traceback.empty()) {
+        out += "\n\n";
+        std::pmr::string traceLine(&arena);
+        for (std::string_view line : output.traceback) {
+            // Remove ANSI escape codes
+            traceLine.clear();
+            stripAnsiCodes(line, traceLine);
+            escapeHTML(traceLine, out);
+            out += "\n";
+        }
+    }
 
-    return outputPath;
+    out += "</div>\n";
 }
 
-std::string JupyterParser::escapeHTML(const std::string& str) {
-    std::string result;
-    result.reserve(str.size());
+void JupyterParser::renderOutputBody(const NotebookOutput& output, std::string& out) {
+    if (output.external) {
+        out += output.text;
+        return;
+    }
 
-    for (char c : str) {
-        switch (c) {
-            case '<':  result += "&lt;";   break;
-            case '>':  result += "&gt;";   break;
-            case '&':  result += "&amp;";  break;
-            case '"':  result += "&quot;"; break;
-            case '\'': result += "&#39;";  break;
-            default:   result += c;        break;
-        }
+    switch (output.type) {
+        case OUTPUT_STREAM: renderStreamOutput(output, out); break;
+        case OUTPUT_DISPLAY_DATA:
+        case OUTPUT_EXECUTE_RESULT: renderDisplayData(output, out); break;
+        case OUTPUT_ERROR: renderErrorOutput(output, out); break;
+        default: break;
+    }
+}
+
+bool JupyterParser::overBudget(const NotebookOutput& output) const {
+    if (output.type == OUTPUT_INVALID || output.type == OUTPUT_OTHER) {
+        return false;
+    }
+    // Image tags are small; their payload is already a file of its own
+    if (output.mimeType == "image/png" || output.mimeType == "image/jpeg") {
+        return false;
     }
 
-    return result;
+    size_t bytes = output.text.size();
+    for (const auto& line : output.traceback) {
+        bytes += line.size();
+    }
+    return bytes > outputBudget;
 }
 
-std::string JupyterParser::joinLines(const json& lines) {
-    if (lines.is_string()) {
-        return lines.get<std::string>();
+bool JupyterParser::externalizeOutput(NotebookOutput& output, const std::string& notebookPath) {
+    if (!overBudget(output)) {
+        return false;
     }
 
-    if (!lines.is_array()) {
-        return "";
+    std::string full;
+    renderOutputBody(output, full);
+    if (full.empty()) {
+        return false;
     }
 
-    std::stringstream result;
-    for (const auto& line : lines) {
-        if (line.is_string()) {
-            result << line.get<std::string>();
+    std::string filename;
+    try {
+        filename = imageStore.storeBytes(full, ".html");
+    } catch (const std::exception& e) {
+        std::cerr << "Error writing notebook output: " << e.what() << std::endl;
+        return false;
+    }
+    std::string url = imageURL(notebookPath) + filename;
+
+    // Text outputs keep their first lines; HTML and SVG cannot be cut safely
+    std::string preview;
+    if (output.type == OUTPUT_ERROR) {
+        preview += "      <div class=\"nb-output-error\"><strong>";
+        escapeHTML(output.errorName, preview);
+        preview += ":</strong> ";
+        escapeHTML(output.errorValue, preview);
+        preview += "</div>\n";
+    } else if (output.mimeType == "text/plain") {
+        std::string_view text = output.text;
+        size_t length = std::min(text.size(), std::min(PREVIEW_BYTES, outputBudget / 2));
+        size_t lineEnd = text.rfind('\n', length);
+        if (lineEnd != std::string_view::npos && lineEnd > 0) {
+            length = lineEnd + 1;
         }
+        preview += "      <pre>";
+        escapeHTML(text.substr(0, length), preview);
+        preview += "</pre>\n";
+    }
+
+    std::pmr::string& html = output.text;
+    html.clear();
+    html += "      ";
+    html += SIDE_FILE_MARKER;
+    html += url;
+    html += "\">\n";
+    html += "        <summary>Show full output (";
+    html += formatSize(full.size());
+    html += ")</summary>\n";
+    html += "        <a class=\"nb-output-link\" href=\"";
+    html += url;
+    html += "\">Open the full output</a>\n";
+    html += "      </details>\n";
+    if (!preview.empty()) {
+        html += "      <div class=\"nb-output-preview\">\n";
+        html += preview;
+        html += "      </div>\n";
     }
 
-    return result.str();
+    output.external = true;
+    output.traceback.clear();
+    return true;
 }
 
-std::string JupyterParser::detectLanguage(const json& metadata) {
-    if (metadata.contains("kernelspec") && metadata["kernelspec"].is_object()) {
-        const json& kernelspec = metadata["kernelspec"];
-        if (kernelspec.contains("language")) {
-            return kernelspec["language"];
+bool JupyterParser::sideFilesPresent(std::string_view html) const {
+    for (size_t pos = html.find(SIDE_FILE_MARKER); pos != std::string_view::npos;
+         pos = html.find(SIDE_FILE_MARKER, pos)) {
+        pos += SIDE_FILE_MARKER.length();
+        size_t end = html.find('"', pos);
+        if (end == std::string_view::npos) return false;
+
+        std::string_view url = html.substr(pos, end - pos);
+        std::string filename(url.substr(url.rfind('/') + 1));
+        if (!fs::exists(fs::path(imageStore.directory()) / filename)) return false;
+    }
+    return true;
+}
+
+std::string JupyterParser::extractBase64Image(std::string_view base64Data,
+                                                std::string_view mimeType,
+                                                const std::string& notebookPath,
+                                                int outputNumber,
+                                                std::vector<std::string>& extractedImages) {
+    try {
+        // Small images go into the page as data: URIs, saving a request each
+        size_t encodedLength = 0;
+        for (char c : base64Data) {
+            if (!std::isspace(static_cast<unsigned char>(c))) encodedLength++;
+        }
+        if (encodedLength / 4 * 3 <= inlineImageBytes) {
+            std::string uri = "data:" + std::string(mimeType) + ";base64,";
+            size_t prefixLength = uri.size();
+            uri.reserve(prefixLength + encodedLength);
+            for (char c : base64Data) {
+                if (!std::isspace(static_cast<unsigned char>(c))) uri += c;
+            }
+            if (!validBase64(std::string_view(uri).substr(prefixLength))) {
+                throw std::runtime_error("Invalid base64 image data");
+            }
+            return imageTag(uri, outputNumber);
         }
+
+        // Determine file extension
+        std::string extension = ".png";
+        if (mimeType == "image/jpeg") {
+            extension = ".jpg";
+        } else if (mimeType == "image/svg+xml") {
+            extension = ".svg";
+        }
+
+        // Store under a name derived from the image bytes
+        std::string filename = storeImage(base64Data, extension);
+        fs::path imagePath = fs::path(imageStore.directory()) / filename;
+
+        // Add to extracted images list
+        extractedImages.push_back(imagePath.string());
+
+        // Return HTML img tag with relative path
+        return imageTag(imageURL(notebookPath) + filename, outputNumber);
+
+    } catch (const std::exception& e) {
+        return "<div class=\"error\">Error extracting image: " + std::string(e.what()) + "</div>";
     }
+}
 
-    return "python";  // Default
+std::string JupyterParser::extractSvgImage(std::string_view svg,
+                                            const std::string& notebookPath,
+                                            int outputNumber,
+                                            std::vector<std::string>& extractedImages) {
+    try {
+        std::string filename = imageStore.storeBytes(svg, ".svg");
+        extractedImages.push_back((fs::path(imageStore.directory()) / filename).string());
+        return imageTag(imageURL(notebookPath) + filename, outputNumber);
+    } catch (const std::exception& e) {
+        return "<div class=\"error\">Error extracting image: " + std::string(e.what()) + "</div>";
+    }
 }
 
-std::string JupyterParser::getPrismLanguageClass(const std::string& language) {
-    if (language == "r" || language == "R") {
-        return "language-r";
-    } else if (language == "julia") {
-        return "language-julia";
-    } else if (language == "bash" || language == "shell") {
-        return "language-bash";
+// Hashing the payload is much cheaper than decoding it, so a payload stored
+// by an earlier build is looked up by that hash instead of being decoded
+// again to find its content-derived name
+std::string JupyterParser::storeImage(std::string_view base64Data, const std::string& extension) {
+    if (!cellCache) {
+        return imageStore.storeBase64(base64Data, extension);
+    }
+
+    CacheKey key(PIECE_IMAGE);
+    key.mixText(base64Data);
+    key.mixText(extension);
+
+    auto cached = cellCache->find(key.hash);
+    if (cached != cellCache->end() && cached->second.check == key.check &&
+        fs::exists(fs::path(imageStore.directory()) / cached->second.html)) {
+        cacheHits.push_back(&cached->second);
+        return cached->second.html;
     }
 
-    return "language-python";  // Default
+    std::string filename = imageStore.storeBase64(base64Data, extension);
+    cacheAdditions.emplace_back(key, filename);
+    return filename;
 }
 
-std::string JupyterParser::base64Decode(const std::string& encoded) {
-    static const std::string base64_chars =
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-        "abcdefghijklmnopqrstuvwxyz"
-        "0123456789+/";
+std::string JupyterParser::imageURL(const std::string& notebookPath) {
+    fs::path nbPath(notebookPath);
+
+    // Calculate correct relative path based on notebook location
+    // Count depth by looking for how many directories deep the notebook is in content/blog/
+    std::string pathStr = nbPath.string();
+    int depth = 1;  // Default for content/blog/notebook.ipynb
 
-    std::string decoded;
-    std::vector<int> T(256, -1);
-    for (int i = 0; i < 64; i++) T[base64_chars[i]] = i;
+    // Count slashes after "content/blog/" or "blog/"
+    size_t blogPos = pathStr.find("content/blog/");
+    if (blogPos == std::string::npos) {
+        blogPos = pathStr.find("blog/");
+    }
 
-    int val = 0, valb = -8;
-    for (unsigned char c : encoded) {
-        if (T[c] == -1) break;
-        val = (val << 6) + T[c];
-        valb += 6;
-        if (valb >= 0) {
-            decoded.push_back(char((val >> valb) & 0xFF));
-            valb -= 8;
+    if (blogPos != std::string::npos) {
+        std::string afterBlog = pathStr.substr(blogPos + (pathStr.find("content/blog/") != std::string::npos ? 13 : 5));
+        depth = 1;  // Start at 1 for files directly in blog/
+        for (char c : afterBlog) {
+            if (c == '/' || c == '\\') depth++;
         }
     }
 
-    return decoded;
+    // Build relative path (e.g., "../images/" or "../../images/" or "../../../images/")
+    std::string relativePath;
+    for (int i = 0; i < depth; i++) {
+        relativePath += "../";
+    }
+    relativePath += "images/notebooks/";
+
+    return relativePath;
 }
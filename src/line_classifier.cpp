@@ -0,0 +1,124 @@
+#include "line_classifier.h"
+#include <array>
+#include <cstring>
+
+namespace {
+
+// Byte classes: blanks that trim() strips, and what a first byte can start
+enum ByteClass : unsigned char {
+    BYTE_OTHER,
+    BYTE_BLANK,
+    BYTE_BACKTICK,
+    BYTE_PIPE,
+    BYTE_HASH,
+    BYTE_BULLET,
+    BYTE_DIGIT
+};
+
+constexpr std::array<unsigned char, 256> buildByteClasses() {
+    std::array<unsigned char, 256> table{};
+    table[' '] = BYTE_BLANK;
+    table['\t'] = BYTE_BLANK;
+    table['\r'] = BYTE_BLANK;
+    table['\n'] = BYTE_BLANK;
+    table['`'] = BYTE_BACKTICK;
+    table['|'] = BYTE_PIPE;
+    table['#'] = BYTE_HASH;
+    table['-'] = BYTE_BULLET;
+    table['*'] = BYTE_BULLET;
+    for (int c = '0'; c <= '9'; c++) {
+        table[c] = BYTE_DIGIT;
+    }
+    return table;
+}
+
+constexpr std::array<unsigned char, 256> BYTE_CLASSES = buildByteClasses();
+
+unsigned char byteClass(char c) {
+    return BYTE_CLASSES[static_cast<unsigned char>(c)];
+}
+
+// Content runs from the first non-blank byte at or after start to end
+void setContent(LineInfo& info, std::string_view line, size_t start, size_t end) {
+    while (start < end && byteClass(line[start]) == BYTE_BLANK) {
+        start++;
+    }
+    info.contentStart = start < end ? start : end;
+    info.contentEnd = end;
+}
+
+} // namespace
+
+LineInfo classifyLine(std::string_view line) {
+    LineInfo info;
+
+    size_t first = 0;
+    while (first < line.length() && byteClass(line[first]) == BYTE_BLANK) {
+        first++;
+    }
+    if (first == line.length()) {
+        return info;
+    }
+
+    size_t last = line.length();
+    while (byteClass(line[last - 1]) == BYTE_BLANK) {
+        last--;
+    }
+    info.kind = LINE_PARAGRAPH;
+    info.contentStart = first;
+    info.contentEnd = last;
+
+    switch (byteClass(line[first])) {
+        case BYTE_BACKTICK:
+            if (last - first >= 3 && line[first + 1] == '`' && line[first + 2] == '`') {
+                info.kind = LINE_FENCE;
+                setContent(info, line, first + 3, last);
+            }
+            break;
+
+        case BYTE_PIPE:
+            // A table row has at least one more | after the first
+            if (std::memchr(line.data() + first + 1, '|', last - first - 1)) {
+                info.kind = LINE_TABLE_ROW;
+            }
+            break;
+
+        case BYTE_HASH: {
+            // Headings start at the first column: 1-6 # followed by a space
+            if (first != 0) break;
+            size_t level = 0;
+            while (level < line.length() && line[level] == '#') {
+                level++;
+            }
+            if (level <= 6 && level < line.length() && line[level] == ' ') {
+                info.kind = LINE_HEADING;
+                info.level = static_cast<int>(level);
+                setContent(info, line, level + 1, last);
+            }
+            break;
+        }
+
+        case BYTE_BULLET:
+            if (last - first > 1 && line[first + 1] == ' ') {
+                info.kind = LINE_BULLET_ITEM;
+                setContent(info, line, first + 1, last);
+            }
+            break;
+
+        case BYTE_DIGIT: {
+            // Any . before the last character makes an ordered item
+            const void* dot = std::memchr(line.data() + first, '.', last - first - 1);
+            if (dot) {
+                info.kind = LINE_ORDERED_ITEM;
+                size_t dotPos = static_cast<const char*>(dot) - line.data();
+                setContent(info, line, dotPos + 1, last);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return info;
+}
@@ -5,10 +5,13 @@
 #include <vector>
 #include <algorithm>
 #include <functional>
+#include <cstdlib>
+#include <cstdint>
 
 // Module includes
 #include "structures.h"
 #include "file_utils.h"
+#include "document_store.h"
 #include "metadata.h"
 #include "cache.h"
 #include "toc.h"
@@ -19,11 +22,11 @@
 #include "template.h"
 #include "listing.h"
 #include "processor.h"
+#include "png_optimizer.h"
 
 // Existing parsers
 #include "markdown_parser.h"
 #include "blog_database.h"
-#include "jupyter_parser.h"
 
 namespace fs = std::filesystem;
 
@@ -33,7 +36,6 @@ int main(int argc, char* argv[]) {
     std::string contentDir = "content";
     std::string blogDir = "content/blog";
     std::string imagesDir = "content/images";
-    std::string notebooksImagesDir = "content/images/notebooks";
     std::string outputDir = "docs";
     std::string blogOutputDir = "docs/blog";
     std::string imagesOutputDir = "docs/images";
@@ -42,6 +44,39 @@ int main(int argc, char* argv[]) {
     std::string cssSourcePath = "templates/style.css";
     std::string cssOutputPath = "docs/style.css";
     std::string cacheFile = ".build_cache";
+    std::string blockCacheFile = ".build_cache_blocks";
+    std::string imageCacheFile = ".build_cache_png";
+
+    // Code is highlighted at build time; --client-highlight keeps the
+    // Prism.js scripts in the template as well. Pages larger than the stream
+    // buffer (--stream-buffer <bytes>) are rendered straight from disk.
+    // Notebook outputs over --output-budget <bytes> move to side files
+    // (0 keeps them all inline), and notebook images up to --inline-images
+    // <bytes> are embedded in the page (0 writes them all to files).
+    // --optimize-png recompresses the notebook PNGs after rendering.
+    bool clientHighlight = false;
+    bool optimizePNG = false;
+    size_t streamBufferSize = 4 * 1024 * 1024;
+    NotebookSettings notebookSettings;
+    notebookSettings.imageDirectory = notebooksImagesOutputDir;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--client-highlight") {
+            clientHighlight = true;
+        } else if (arg == "--optimize-png") {
+            optimizePNG = true;
+        } else if (arg == "--stream-buffer" && i + 1 < argc) {
+            unsigned long long size = std::strtoull(argv[++i], nullptr, 10);
+            if (size > 0) {
+                streamBufferSize = static_cast<size_t>(size);
+            }
+        } else if (arg == "--output-budget" && i + 1 < argc) {
+            unsigned long long size = std::strtoull(argv[++i], nullptr, 10);
+            notebookSettings.outputBudget = size > 0 ? static_cast<size_t>(size) : SIZE_MAX;
+        } else if (arg == "--inline-images" && i + 1 < argc) {
+            notebookSettings.inlineImageBytes = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+        }
+    }
 
     // Create output directories if they don't exist
     if (!fs::exists(outputDir)) {
@@ -53,9 +88,6 @@ int main(int argc, char* argv[]) {
     if (!fs::exists(imagesOutputDir)) {
         fs::create_directory(imagesOutputDir);
     }
-    if (!fs::exists(notebooksImagesDir)) {
-        fs::create_directories(notebooksImagesDir);
-    }
     if (!fs::exists(notebooksImagesOutputDir)) {
         fs::create_directories(notebooksImagesOutputDir);
     }
@@ -109,6 +141,9 @@ int main(int argc, char* argv[]) {
     // Load cache
     std::map<std::string, CachedMetadata> cache = loadCache(cacheFile);
     std::map<std::string, CachedMetadata> newCache;
+    std::unordered_map<size_t, CachedBlock> blockCache = loadBlockCache(blockCacheFile);
+    notebookSettings.cellCache = &blockCache;
+    configureNotebooks(notebookSettings, cache);
 
     // Read template
     std::string templateContent = readFile(templatePath);
@@ -116,11 +151,15 @@ int main(int argc, char* argv[]) {
         std::cerr << "Error: Could not read template file" << std::endl;
         return 1;
     }
+    if (!clientHighlight) {
+        templateContent = stripClientHighlighting(templateContent);
+    }
 
     // Hash template content
     std::string templateHash = std::to_string(hashString(templateContent));
 
     MarkdownParser parser;
+    parser.setBlockCache(&blockCache);
     std::vector<Page> pages;
     std::vector<BlogPost> blogPosts;
 
@@ -138,24 +177,30 @@ int main(int argc, char* argv[]) {
             std::string outputFilename = entry.path().stem().string() + ".html";
             std::string outputPath = outputDir + "/" + outputFilename;
 
-            std::string markdownContent = readFile(filepath);
-            if (markdownContent.empty()) continue;
-
-            std::string title = extractTitle(markdownContent);
-
             Page page;
             page.filename = filename;
-            page.title = title;
             page.outputPath = outputFilename;
 
+            // Large pages are never read whole; they stream when written
+            if (fs::file_size(entry.path()) > streamBufferSize) {
+                std::ifstream in(filepath);
+                page.title = parser.readTitle(in);
+                page.sourcePath = filepath;
+            } else {
+                const SourceFile& source = loadSourceFile(filepath);
+                if (source.content.empty()) continue;
+                page.title = source.document.title;
+            }
+
             if (!needsPageRegeneration(filepath, outputPath, cache)) {
                 std::cout << "Skipping (up-to-date): " << filename << std::endl;
                 skippedPages++;
                 newCache[filepath] = cache[filepath];
             } else {
                 std::cout << "Processing page: " << filename << std::endl;
-                std::string htmlContent = parser.convertToHTML(markdownContent);
-                page.content = htmlContent;
+                if (page.sourcePath.empty()) {
+                    page.content = parser.renderHTML(sourceDocument(filepath));
+                }
                 pagesToGenerate.push_back(page);
 
                 CachedMetadata metadata;
@@ -195,8 +240,15 @@ int main(int argc, char* argv[]) {
         if (blogTree) {
             std::vector<NavigationItem> emptyNav;
 
-            // Process the entire blog tree recursively
-            processContentNode(blogTree, "docs", templateContent, parser, emptyNav, cache, newCache, templateHash);
+            // Process the subdirectories recursively. Files directly in the
+            // blog directory are uncategorized posts, rendered and written
+            // once by the loop below.
+            for (ContentNode* child : blogTree->children) {
+                if (child->type == NODE_DIRECTORY) {
+                    processContentNode(child, "docs", templateContent, parser, emptyNav, cache, newCache,
+                                       templateHash);
+                }
+            }
 
             // Generate listing pages for all subdirectories
             std::cout << "\n[INFO] Generating listing pages for subdirectories..." << std::endl;
@@ -237,63 +289,26 @@ int main(int argc, char* argv[]) {
                 std::string outputFilename = entry.path().stem().string() + ".html";
                 std::string outputPath = blogOutputDir + "/" + outputFilename;
 
-                std::string fileContent = readFile(filepath);
-                if (fileContent.empty()) continue;
+                const SourceFile& source = loadSourceFile(filepath);
+                if (source.size == 0) continue;
 
                 std::string title;
                 std::string excerpt;
-                std::string htmlContent;
-                std::vector<std::string> extractedImages;
 
                 if (extension == ".ipynb") {
-                    JupyterParser jupyterParser;
-                    htmlContent = jupyterParser.convertToHTML(fileContent, filepath, extractedImages);
-
-                    try {
-                        json notebook = json::parse(fileContent);
-                        bool foundTitle = false;
-                        if (notebook.contains("cells")) {
-                            for (const auto& cell : notebook["cells"]) {
-                                if (cell["cell_type"] == "markdown" && cell.contains("source")) {
-                                    std::string source;
-                                    if (cell["source"].is_string()) {
-                                        source = cell["source"];
-                                    } else if (cell["source"].is_array() && !cell["source"].empty()) {
-                                        source = cell["source"][0];
-                                    }
-                                    if (source.find("# ") == 0) {
-                                        title = source.substr(2);
-                                        if (!title.empty() && title.back() == '\n') {
-                                            title.pop_back();
-                                        }
-                                        foundTitle = true;
-                                        break;
-                                    }
-                                }
-                            }
-                        }
-                        if (!foundTitle) {
-                            title = entry.path().stem().string();
-                        }
-                    } catch (...) {
+                    title = source.notebook.title;
+                    if (title.empty()) {
                         title = entry.path().stem().string();
                     }
 
                     excerpt = "Jupyter notebook";
-
-                    for (const auto& imagePath : extractedImages) {
-                        fs::path imgPath(imagePath);
-                        std::string destPath = "docs/images/notebooks/" + imgPath.filename().string();
-                        try {
-                            fs::copy_file(imagePath, destPath, fs::copy_options::overwrite_existing);
-                        } catch (const fs::filesystem_error& e) {
-                            std::cerr << "Error copying image: " << e.what() << std::endl;
-                        }
-                    }
                 } else {
-                    title = extractTitle(fileContent);
-                    std::string excerptMarkdown = extractExcerpt(fileContent);
-                    excerpt = parser.convertToHTML(excerptMarkdown);
+                    title = source.document.title;
+                    // Excerpts are one-off snippets; caching their blocks
+                    // would only crowd out the pages' entries
+                    parser.setBlockCache(nullptr);
+                    parser.convertToHTML(source.document.excerpt, excerpt);
+                    parser.setBlockCache(&blockCache);
                 }
 
                 std::string publishDate;
@@ -317,22 +332,22 @@ int main(int argc, char* argv[]) {
                 post.timestamp = timestamp;
                 post.category = "";
 
-                if (!needsBlogRegeneration(filepath, fileContent, outputPath, templateHash, cache)) {
+                if (!needsBlogRegeneration(filepath, source.hash, outputPath, templateHash, cache)) {
                     std::cout << "Skipping (up-to-date): " << filename << " [uncategorized]" << std::endl;
                     skippedBlogs++;
                     newCache[filepath] = cache[filepath];
                 } else {
                     std::cout << "Processing blog: " << filename << " [uncategorized]" << std::endl;
 
+                    // Rendered when written, so only one post's HTML is held at a time
                     if (extension == ".md") {
-                        htmlContent = parser.convertToHTML(fileContent);
+                        post.toc = generateTOC(source.document);
                     }
-
-                    post.content = htmlContent;
+                    post.sourcePath = filepath;
                     blogsToGenerate.push_back(post);
 
                     CachedMetadata metadata;
-                    metadata.contentHash = hashString(fileContent + templateHash);
+                    metadata.contentHash = pageHash(source.hash, templateHash);
                     metadata.publishDate = publishDate;
                     metadata.timestamp = timestamp;
                     metadata.fileModTime = 0;
@@ -448,8 +463,14 @@ int main(int argc, char* argv[]) {
 
     // Generate HTML files for pages
     for (const auto& page : pagesToGenerate) {
-        std::string finalHtml = applyTemplate(templateContent, page.title, page.content, pages);
         std::string outputPath = outputDir + "/" + page.outputPath;
+        if (!page.sourcePath.empty()) {
+            streamMarkdownPage(page.sourcePath, outputPath, templateContent, page.title, pages, 0,
+                               parser, streamBufferSize);
+            continue;
+        }
+
+        std::string finalHtml = applyTemplate(templateContent, page.title, page.content, pages);
         writeFile(outputPath, finalHtml);
     }
 
@@ -457,21 +478,17 @@ int main(int argc, char* argv[]) {
     for (const auto& post : blogsToGenerate) {
         int depth = post.category.empty() ? 1 : 2;
 
-        std::string tocHtml = "";
-        std::string markdownPath;
-        if (!post.category.empty()) {
-            markdownPath = blogDir + "/" + post.category + "/" + post.filename;
+        std::string finalHtml;
+        if (post.sourcePath.empty()) {
+            finalHtml = applyTemplate(templateContent, post.title, post.content, pages, depth, post.toc);
+        } else if (fs::path(post.sourcePath).extension() == ".ipynb") {
+            finalHtml = applyTemplate(templateContent, post.title, renderNotebook(post.sourcePath), pages, depth,
+                                      post.toc);
         } else {
-            markdownPath = blogDir + "/" + post.filename;
+            std::string content = parser.renderHTML(sourceDocument(post.sourcePath));
+            finalHtml = applyTemplate(templateContent, post.title, content, pages, depth, post.toc);
         }
 
-        if (fs::exists(markdownPath)) {
-            std::string markdown = readFile(markdownPath);
-            tocHtml = generateTOC(markdown);
-        }
-
-        std::string finalHtml = applyTemplate(templateContent, post.title, post.content, pages, depth, tocHtml);
-
         std::string outputPath;
         if (!post.category.empty()) {
             outputPath = blogOutputDir + "/" + post.category + "/" + post.outputPath;
@@ -480,10 +497,32 @@ int main(int argc, char* argv[]) {
         }
 
         writeFile(outputPath, finalHtml);
+        if (!post.sourcePath.empty()) {
+            releaseSourceFile(post.sourcePath);
+        }
     }
 
-    // Save cache
+    // Recompress the notebook images losslessly, skipping the ones an
+    // earlier build already did
+    if (optimizePNG) {
+        std::unordered_set<uint64_t> imageCache = loadImageCache(imageCacheFile);
+        PNGOptimizeStats stats = optimizePNGImages(notebooksImagesOutputDir, imageCache);
+        saveImageCache(imageCacheFile, imageCache);
+        std::cout << "Optimized PNG images: " << stats.recompressed << " of " << stats.files << " recompressed ("
+                  << stats.bytesBefore << " -> " << stats.bytesAfter << " bytes), " << stats.cached
+                  << " already optimized" << std::endl;
+    }
+
+    // Save cache, with the summary of every notebook so the next build can
+    // skip parsing the unchanged ones
+    for (auto& entry : newCache) {
+        if (fs::path(entry.first).extension() == ".ipynb") {
+            entry.second.hasNotebook = true;
+            entry.second.notebook = loadSourceFile(entry.first).notebook;
+        }
+    }
     saveCache(cacheFile, newCache);
+    saveBlockCache(blockCacheFile, blockCache, 32 * 1024 * 1024);
 
     std::cout << "\n=== Site generation complete! ===" << std::endl;
     std::cout << "Processed " << pages.size() << " pages (" << pagesToGenerate.size() << " generated, "
@@ -1,364 +1,616 @@
 #include "../include/markdown_parser.h"
-#include <regex>
-#include <sstream>
+#include "../include/line_iterator.h"
+#include "../include/highlighter.h"
+#include "../include/line_classifier.h"
+#include "../include/slug.h"
+#include "../include/escape.h"
+#include "../include/hash.h"
+#include "../include/thread_pool.h"
 #include <algorithm>
+#include <functional>
 
-MarkdownParser::MarkdownParser() {}
+namespace {
 
-std::string MarkdownParser::convertToHTML(const std::string& markdown) {
-    std::stringstream html;
-    std::stringstream ss(markdown);
-    std::string line;
+// Collects the listing excerpt line by line: skips headings, blank lines and
+// the first line after a heading, then joins the rest up to maxLength
+struct ExcerptBuilder {
+    std::pmr::string excerpt;
+    size_t maxLength;
+    bool skippedHeader;
+    bool skippedSecondLine;
+    bool done;
 
-    bool inCodeBlock = false;
-    bool inList = false;
-    bool isOrdered = false;
-    bool inParagraph = false;
-    bool inTable = false;
-    std::string codeContent;
-    std::vector<std::string> tableLines;
-
-    while (std::getline(ss, line)) {
-        // Handle code blocks
-        if (isCodeBlockDelimiter(line)) {
-            std::string codeHtml = parseCodeBlock(line, inCodeBlock, codeContent);
-            if (!codeHtml.empty()) {
-                if (inList) {
-                    html << (isOrdered ? "</ol>\n" : "</ul>\n");
-                    inList = false;
-                }
-                if (inParagraph) {
-                    html << "</p>\n";
-                    inParagraph = false;
-                }
-                if (inTable) {
-                    html << parseTable(tableLines);
-                    tableLines.clear();
-                    inTable = false;
-                }
-                html << codeHtml;
-            }
-            continue;
-        }
+    ExcerptBuilder(size_t maxLength, std::pmr::memory_resource* resource)
+        : excerpt(resource), maxLength(maxLength), skippedHeader(false), skippedSecondLine(false), done(false) {}
 
-        if (inCodeBlock) {
-            codeContent += line + "\n";
-            continue;
-        }
+    void addLine(std::string_view line) {
+        if (done) return;
 
-        // Handle tables
-        if (isTableRow(line)) {
-            if (inList) {
-                html << (isOrdered ? "</ol>\n" : "</ul>\n");
-                inList = false;
-            }
-            if (inParagraph) {
-                html << "</p>\n";
-                inParagraph = false;
-            }
-            inTable = true;
-            tableLines.push_back(line);
-            continue;
-        } else if (inTable) {
-            // End of table
-            html << parseTable(tableLines);
-            tableLines.clear();
-            inTable = false;
-        }
-
-        // Handle empty lines
-        if (isEmptyLine(line)) {
-            if (inList) {
-                html << (isOrdered ? "</ol>\n" : "</ul>\n");
-                inList = false;
-            }
-            if (inParagraph) {
-                html << "</p>\n";
-                inParagraph = false;
-            }
-            continue;
+        if (!line.empty() && line[0] == '#') {
+            skippedHeader = true;
+            return;
         }
+        if (line.empty()) return;
 
-        // Handle headers
-        if (isHeader(line)) {
-            if (inList) {
-                html << (isOrdered ? "</ol>\n" : "</ul>\n");
-                inList = false;
-            }
-            if (inParagraph) {
-                html << "</p>\n";
-                inParagraph = false;
-            }
-            html << parseHeaders(line) << "\n";
-            continue;
+        if (skippedHeader && !skippedSecondLine) {
+            skippedSecondLine = true;
+            return;
         }
 
-        // Handle lists
-        if (isListItem(line)) {
-            std::string listHtml = parseList(line, inList, isOrdered);
-            if (inParagraph) {
-                html << "</p>\n";
-                inParagraph = false;
-            }
-            html << listHtml << "\n";
-            continue;
+        if (!excerpt.empty()) {
+            excerpt += " ";
         }
+        excerpt.append(line.data(), line.length());
 
-        // Handle regular paragraphs
-        if (inList) {
-            html << (isOrdered ? "</ol>\n" : "</ul>\n");
-            inList = false;
+        if (excerpt.length() >= maxLength) {
+            done = true;
         }
+    }
 
-        if (!inParagraph) {
-            html << "<p>";
-            inParagraph = true;
-        } else {
-            html << " ";
+    std::pmr::string finish() {
+        // Truncate to maxLength and add ellipsis if needed
+        if (excerpt.length() > maxLength) {
+            excerpt.resize(maxLength);
+            size_t lastSpace = excerpt.find_last_of(' ');
+            if (lastSpace != std::string::npos) {
+                excerpt.resize(lastSpace);
+            }
+            excerpt += "...";
         }
+        return std::move(excerpt);
+    }
+};
 
-        std::string processedLine = line;
-        processedLine = parseImages(processedLine);
-        processedLine = parseLinks(processedLine);
-        processedLine = parseBold(processedLine);
-        processedLine = parseItalic(processedLine);
-        processedLine = parseInlineCode(processedLine);
+// The source text of a block's lines, which are contiguous in the markdown
+std::string_view blockSource(const MarkdownDocument& doc, const MarkdownBlock& block) {
+    if (block.lineCount == 0) return std::string_view();
 
-        html << processedLine;
-    }
+    const std::string_view& first = doc.lines[block.firstLine];
+    const std::string_view& last = doc.lines[block.firstLine + block.lineCount - 1];
+    return std::string_view(first.data(), last.data() + last.length() - first.data());
+}
 
-    // Close any open tags
-    if (inList) {
-        html << (isOrdered ? "</ol>\n" : "</ul>\n");
-    }
-    if (inParagraph) {
-        html << "</p>\n";
-    }
-    if (inTable) {
-        html << parseTable(tableLines);
-    }
-    if (inCodeBlock && !codeContent.empty()) {
-        html << "<pre><code>" << escapeHTML(codeContent) << "</code></pre>\n";
+// Blocks cut a parallel render into runs of about this many source bytes
+constexpr size_t PARALLEL_RUN_BYTES = 256 * 1024;
+
+// A run of consecutive blocks rendered by one task of a parallel render.
+// Cache hits and newly rendered blocks are recorded, not written, so the
+// shared block cache is only read while tasks run.
+struct BlockRun {
+    size_t firstBlock;
+    size_t endBlock;
+    size_t firstHeading;
+    size_t sourceBytes;
+    std::string html;
+
+    struct Rendered {
+        CacheKey key;
+        size_t start;
+        size_t length;
+    };
+    std::vector<Rendered> rendered;
+    std::vector<CachedBlock*> hits;
+};
+
+// Offset just past the last complete line after which no block is open (a
+// blank line, a heading or a closing fence outside code), or 0 if none.
+// inCodeBlock is set if the text starts inside a fenced code block.
+size_t lastBlockBoundary(std::string_view text, bool inCodeBlock) {
+    size_t boundary = 0;
+
+    size_t pos = 0;
+    size_t newline = text.find('\n');
+    while (newline != std::string_view::npos) {
+        LineInfo info = classifyLine(text.substr(pos, newline - pos));
+        if (info.kind == LINE_FENCE) {
+            if (inCodeBlock) boundary = newline + 1;
+            inCodeBlock = !inCodeBlock;
+        } else if (!inCodeBlock && (info.kind == LINE_EMPTY || info.kind == LINE_HEADING)) {
+            boundary = newline + 1;
+        }
+
+        pos = newline + 1;
+        newline = text.find('\n', pos);
     }
 
-    return html.str();
+    return boundary;
 }
 
-std::string MarkdownParser::parseHeaders(const std::string& line) {
-    size_t level = 0;
-    size_t i = 0;
+} // namespace
 
-    while (i < line.length() && line[i] == '#') {
-        level++;
-        i++;
-    }
+MarkdownParser::MarkdownParser() : blockCache(nullptr), parallelThreshold(1 << 20) {}
 
-    if (level > 0 && level <= 6 && i < line.length() && line[i] == ' ') {
-        std::string rawContent = trim(line.substr(i + 1));
-
-        // Create anchor ID from heading text (lowercase, replace spaces with hyphens)
-        std::string anchorId = rawContent;
-        std::transform(anchorId.begin(), anchorId.end(), anchorId.begin(), ::tolower);
-        std::replace(anchorId.begin(), anchorId.end(), ' ', '-');
-        // Remove special characters
-        anchorId.erase(std::remove_if(anchorId.begin(), anchorId.end(),
-            [](char c) { return !std::isalnum(c) && c != '-'; }), anchorId.end());
-
-        std::string content = rawContent;
-        content = parseImages(content);
-        content = parseBold(content);
-        content = parseItalic(content);
-        content = parseLinks(content);
-        content = parseInlineCode(content);
-
-        return "<h" + std::to_string(level) + " id=\"" + anchorId + "\">" + content + "</h" + std::to_string(level) + ">";
+std::string MarkdownParser::convertToHTML(const std::string& markdown) {
+    std::string html;
+    html.reserve(markdown.size() + markdown.size() / 4);
+    convertToHTML(markdown, html);
+    return html;
+}
+
+void MarkdownParser::convertToHTML(std::string_view markdown, std::string& out) {
+    {
+        SlugGenerator slugs(&arena);
+        MarkdownDocument doc(&arena);
+        parseDocument(markdown, slugs, 200, doc);
+        renderHTML(doc, out);
     }
+    arena.reset();
+}
 
-    return line;
+MarkdownDocument MarkdownParser::parseDocument(std::string_view markdown, size_t excerptLength) {
+    SlugGenerator slugs;
+    return parseDocument(markdown, slugs, excerptLength);
 }
 
-std::string MarkdownParser::parseBold(const std::string& line) {
-    std::string result = line;
+MarkdownDocument MarkdownParser::parseDocument(std::string_view markdown, SlugGenerator& slugs,
+                                               size_t excerptLength) {
+    MarkdownDocument doc;
+    parseDocument(markdown, slugs, excerptLength, doc);
+    return doc;
+}
 
-    // Bold with **text**
-    std::regex boldAsterisk("\\*\\*([^*]+)\\*\\*");
-    result = std::regex_replace(result, boldAsterisk, "<strong>$1</strong>");
+void MarkdownParser::parseDocument(std::string_view markdown, SlugGenerator& slugs, size_t excerptLength,
+                                   MarkdownDocument& doc, const MarkdownBlock* openBlock) {
+    std::pmr::memory_resource* resource = doc.lines.get_allocator().resource();
+    doc.lines.reserve(std::count(markdown.begin(), markdown.end(), '\n') + 1);
 
-    // Bold with __text__
-    std::regex boldUnderscore("__(.+?)__");
-    result = std::regex_replace(result, boldUnderscore, "<strong>$1</strong>");
+    LineIterator lines(markdown);
+    std::string_view line;
 
-    return result;
-}
+    ExcerptBuilder excerpt(excerptLength, resource);
+    bool foundTitle = false;
+    bool inCodeBlock = false;
+    bool blockOpen = false;
+
+    // Start a new block at the current line, or extend the open one
+    auto addLine = [&](MarkdownBlockType type, bool extend) {
+        if (!extend) {
+            doc.blocks.emplace_back();
+            doc.blocks.back().type = type;
+            doc.blocks.back().firstLine = doc.lines.size();
+        }
+        doc.lines.push_back(line);
+        doc.blocks.back().lineCount++;
+    };
+
+    // The first lines extend a block carried over from the previous window
+    if (openBlock) {
+        doc.blocks.emplace_back();
+        MarkdownBlock& block = doc.blocks.back();
+        block.type = openBlock->type;
+        block.ordered = openBlock->ordered;
+        block.language = openBlock->language;
+        block.continued = true;
+        inCodeBlock = block.type == BLOCK_CODE;
+        blockOpen = !inCodeBlock;
+    }
+
+    while (lines.next(line)) {
+        // Title and excerpt follow the raw lines, code blocks included
+        if (!foundTitle && line.length() > 2 && line[0] == '#' && line[1] == ' ') {
+            doc.title.assign(line.data() + 2, line.length() - 2);
+            foundTitle = true;
+        }
+        excerpt.addLine(line);
+
+        LineInfo info = classifyLine(line);
+
+        // Handle code blocks
+        if (info.kind == LINE_FENCE) {
+            if (inCodeBlock) {
+                doc.blocks.back().closed = true;
+                inCodeBlock = false;
+                blockOpen = false;
+            } else {
+                doc.blocks.emplace_back();
+                doc.blocks.back().type = BLOCK_CODE;
+                doc.blocks.back().firstLine = doc.lines.size();
+                std::string_view fenceInfo = info.content(line);
+                doc.blocks.back().language = fenceInfo.substr(0, fenceInfo.find_first_of(" \t{"));
+                inCodeBlock = true;
+            }
+            continue;
+        }
+
+        if (inCodeBlock) {
+            addLine(BLOCK_CODE, true);
+            continue;
+        }
 
-std::string MarkdownParser::parseItalic(const std::string& line) {
-    std::string result = line;
+        switch (info.kind) {
+            case LINE_TABLE_ROW:
+                addLine(BLOCK_TABLE, blockOpen && doc.blocks.back().type == BLOCK_TABLE);
+                blockOpen = true;
+                break;
+
+            case LINE_EMPTY:
+                blockOpen = false;
+                break;
+
+            case LINE_HEADING: {
+                addLine(BLOCK_HEADING, false);
+                blockOpen = false;
+
+                MarkdownHeading heading(resource);
+                heading.level = info.level;
+                heading.text = info.content(line);
+                heading.anchor = slugs.next(heading.text);
+                doc.headings.push_back(std::move(heading));
+                break;
+            }
 
-    // Italic with *text* (but not **text**)
-    std::regex italicAsterisk("(^|[^*])\\*(?!\\*)([^*]+?)\\*(?!\\*)");
-    result = std::regex_replace(result, italicAsterisk, "$1<em>$2</em>");
+            case LINE_BULLET_ITEM:
+            case LINE_ORDERED_ITEM: {
+                bool ordered = info.kind == LINE_ORDERED_ITEM;
+                bool extend = blockOpen && doc.blocks.back().type == BLOCK_LIST &&
+                              doc.blocks.back().ordered == ordered;
+                addLine(BLOCK_LIST, extend);
+                doc.blocks.back().ordered = ordered;
+                blockOpen = true;
+                break;
+            }
 
-    // Italic with _text_ (but not __text__)
-    std::regex italicUnderscore("(^|[^_])_(?!_)([^_]+?)_(?!_)");
-    result = std::regex_replace(result, italicUnderscore, "$1<em>$2</em>");
+            default:
+                // Regular paragraphs
+                addLine(BLOCK_PARAGRAPH, blockOpen && doc.blocks.back().type == BLOCK_PARAGRAPH);
+                blockOpen = true;
+                break;
+        }
+    }
 
-    return result;
+    if (!foundTitle) {
+        doc.title = "Untitled";
+    }
+    doc.excerpt = excerpt.finish();
 }
 
-std::string MarkdownParser::parseLinks(const std::string& line) {
-    std::regex linkRegex("\\[([^\\]]+)\\]\\(([^)]+)\\)");
-    return std::regex_replace(line, linkRegex, "<a href=\"$2\">$1</a>");
+std::string MarkdownParser::renderHTML(const MarkdownDocument& doc) {
+    std::string html;
+    renderHTML(doc, html);
+    return html;
 }
 
-std::string MarkdownParser::parseImages(const std::string& line) {
-    std::regex imageRegex("!\\[([^\\]]*)\\]\\(([^)]+)\\)");
-    return std::regex_replace(line, imageRegex, "<img src=\"$2\" alt=\"$1\">");
+void MarkdownParser::setBlockCache(std::unordered_map<size_t, CachedBlock>* cache) {
+    blockCache = cache;
 }
 
-std::string MarkdownParser::parseInlineCode(const std::string& line) {
-    std::regex codeRegex("`([^`]+)`");
-    return std::regex_replace(line, codeRegex, "<code>$1</code>");
+void MarkdownParser::setParallelThreshold(size_t bytes) {
+    parallelThreshold = bytes;
 }
 
-std::string MarkdownParser::parseList(const std::string& line, bool& inList, bool& isOrdered) {
-    std::string trimmedLine = trim(line);
-    std::stringstream html;
+void MarkdownParser::renderHTML(const MarkdownDocument& doc, std::string& out) {
+    size_t sourceBytes = 0;
+    for (const auto& block : doc.blocks) {
+        sourceBytes += blockSource(doc, block).length();
+    }
+    if (sourceBytes >= parallelThreshold && ThreadPool::shared().concurrency() > 1) {
+        renderParallel(doc, sourceBytes, out);
+        return;
+    }
 
-    bool currentIsOrdered = (trimmedLine.length() > 0 && std::isdigit(trimmedLine[0]));
+    size_t headingIndex = 0;
+
+    for (const auto& block : doc.blocks) {
+        const std::pmr::string* anchorId = nullptr;
+        if (block.type == BLOCK_HEADING) {
+            anchorId = &doc.headings[headingIndex++].anchor;
+        }
 
-    if (!inList) {
-        html << (currentIsOrdered ? "<ol>\n" : "<ul>\n");
-        inList = true;
-        isOrdered = currentIsOrdered;
-    } else if (isOrdered != currentIsOrdered) {
-        html << (isOrdered ? "</ol>\n" : "</ul>\n");
-        html << (currentIsOrdered ? "<ol>\n" : "<ul>\n");
-        isOrdered = currentIsOrdered;
+        if (!blockCache) {
+            renderBlock(doc, block, anchorId, out);
+            continue;
+        }
+
+        // Blocks render independently of each other, so unchanged source
+        // can reuse the HTML from an earlier build
+        CacheKey key = blockKey(doc, block, anchorId);
+        auto cached = blockCache->find(key.hash);
+        if (cached != blockCache->end() && cached->second.check == key.check) {
+            out += cached->second.html;
+            cached->second.used = true;
+            continue;
+        }
+
+        size_t start = out.size();
+        renderBlock(doc, block, anchorId, out);
+
+        CachedBlock& entry = (*blockCache)[key.hash];
+        entry.html.assign(out, start, std::string::npos);
+        entry.check = key.check;
+        entry.used = true;
     }
+}
 
-    size_t contentStart = 0;
-    if (currentIsOrdered) {
-        contentStart = trimmedLine.find('.') + 1;
-    } else {
-        contentStart = (trimmedLine[0] == '-' || trimmedLine[0] == '*') ? 1 : 0;
+// Blocks render independently, so a large document is cut into runs of
+// blocks that separate parsers render at the same time, joined in order
+void MarkdownParser::renderParallel(const MarkdownDocument& doc, size_t sourceBytes, std::string& out) {
+    ThreadPool& pool = ThreadPool::shared();
+    size_t runBytes = std::max(PARALLEL_RUN_BYTES, sourceBytes / (pool.concurrency() * 4));
+
+    std::vector<BlockRun> runs;
+    size_t headingIndex = 0;
+    for (size_t i = 0; i < doc.blocks.size(); i++) {
+        if (runs.empty() || runs.back().sourceBytes >= runBytes) {
+            runs.emplace_back();
+            runs.back().firstBlock = i;
+            runs.back().firstHeading = headingIndex;
+            runs.back().sourceBytes = 0;
+        }
+        runs.back().endBlock = i + 1;
+        runs.back().sourceBytes += blockSource(doc, doc.blocks[i]).length();
+        if (doc.blocks[i].type == BLOCK_HEADING) {
+            headingIndex++;
+        }
     }
 
-    std::string content = trim(trimmedLine.substr(contentStart));
-    content = parseImages(content);
-    content = parseBold(content);
-    content = parseItalic(content);
-    content = parseLinks(content);
-    content = parseInlineCode(content);
+    pool.parallelFor(runs.size(), [&](size_t index) {
+        BlockRun& run = runs[index];
+        MarkdownParser renderer;
+        run.html.reserve(run.sourceBytes + run.sourceBytes / 4);
+
+        size_t heading = run.firstHeading;
+        for (size_t i = run.firstBlock; i < run.endBlock; i++) {
+            const MarkdownBlock& block = doc.blocks[i];
+            const std::pmr::string* anchorId = nullptr;
+            if (block.type == BLOCK_HEADING) {
+                anchorId = &doc.headings[heading++].anchor;
+            }
 
-    html << "  <li>" << content << "</li>";
+            if (!blockCache) {
+                renderer.renderBlock(doc, block, anchorId, run.html);
+                continue;
+            }
 
-    return html.str();
-}
+            CacheKey key = blockKey(doc, block, anchorId);
+            auto cached = blockCache->find(key.hash);
+            if (cached != blockCache->end() && cached->second.check == key.check) {
+                run.html += cached->second.html;
+                run.hits.push_back(&cached->second);
+                continue;
+            }
 
-std::string MarkdownParser::parseCodeBlock(const std::string& line, bool& inCodeBlock, std::string& codeContent) {
-    if (isCodeBlockDelimiter(line)) {
-        if (inCodeBlock) {
-            std::string html = "<pre><code>" + escapeHTML(codeContent) + "</code></pre>";
-            codeContent.clear();
-            inCodeBlock = false;
-            return html;
-        } else {
-            inCodeBlock = true;
-            return "";
+            size_t start = run.html.size();
+            renderer.renderBlock(doc, block, anchorId, run.html);
+            run.rendered.push_back({key, start, run.html.size() - start});
+        }
+    });
+
+    size_t total = out.size();
+    for (const auto& run : runs) {
+        total += run.html.size();
+    }
+    out.reserve(total);
+
+    for (const auto& run : runs) {
+        out += run.html;
+        for (CachedBlock* hit : run.hits) {
+            hit->used = true;
+        }
+        for (const auto& rendered : run.rendered) {
+            CachedBlock& entry = (*blockCache)[rendered.key.hash];
+            entry.html.assign(run.html, rendered.start, rendered.length);
+            entry.check = rendered.key.check;
+            entry.used = true;
         }
     }
-    return "";
 }
 
-std::string MarkdownParser::parseParagraph(const std::string& line) {
-    std::string content = line;
-    content = parseImages(content);
-    content = parseBold(content);
-    content = parseItalic(content);
-    content = parseLinks(content);
-    content = parseInlineCode(content);
+void MarkdownParser::renderStream(std::istream& in, std::ostream& out, size_t bufferSize) {
+    std::unordered_map<size_t, CachedBlock>* savedCache = blockCache;
+    blockCache = nullptr;
+
+    bufferSize = std::max<size_t>(bufferSize, 1);
+    size_t windowSize = bufferSize;
+    SlugGenerator slugs;
+    std::string window;
+    std::string html;
+
+    // A block cut off at the end of the previous window. Its language is
+    // copied, since the window text it pointed into is gone.
+    MarkdownBlock openBlock;
+    std::string openLanguage;
+    bool hasOpenBlock = false;
+
+    while (true) {
+        // Top the window up from the stream
+        if (window.size() < windowSize) {
+            size_t filled = window.size();
+            window.resize(windowSize);
+            in.read(&window[filled], windowSize - filled);
+            window.resize(filled + static_cast<size_t>(in.gcount()));
+        }
+        bool atEnd = !in;
+
+        // Windows end where no block is open, so each parses on its own. If a
+        // single block fills the window, cut it after its last complete line.
+        bool inCodeBlock = hasOpenBlock && openBlock.type == BLOCK_CODE;
+        size_t cut = atEnd ? window.size() : lastBlockBoundary(window, inCodeBlock);
+        bool cutInBlock = cut == 0 && !atEnd;
+        if (cutInBlock) {
+            cut = window.rfind('\n') + 1;
+        }
 
-    return "<p>" + content + "</p>";
-}
+        bool rendered = false;
+        {
+            // Slugs span windows; each window's document is dropped right away
+            MarkdownDocument doc(&arena);
+            parseDocument(std::string_view(window).substr(0, cut), slugs, 200, doc,
+                          hasOpenBlock ? &openBlock : nullptr);
+
+            if (cutInBlock && !doc.blocks.empty()) {
+                // A block that only began on the last line waits for the next
+                // window: a table's second row decides its header, and a
+                // fence with no code yet may turn out to be empty
+                MarkdownBlock& last = doc.blocks.back();
+                size_t begun = last.type == BLOCK_CODE ? 0 : 1;
+                if (!last.continued && last.lineCount == begun) {
+                    cut = cut >= 2 ? window.rfind('\n', cut - 2) + 1 : 0;
+                    doc.lines.resize(last.firstLine);
+                    doc.blocks.pop_back();
+                } else {
+                    last.unfinished = true;
+                }
+            }
 
-bool MarkdownParser::isHeader(const std::string& line) {
-    if (line.empty()) return false;
-    if (line[0] != '#') return false;
+            // A line longer than the window leaves nothing to render; grow it
+            if (cut > 0 || atEnd) {
+                renderHTML(doc, html);
+                rendered = true;
 
-    size_t i = 0;
-    while (i < line.length() && line[i] == '#') {
-        i++;
+                hasOpenBlock = cutInBlock && !doc.blocks.empty() && doc.blocks.back().unfinished;
+                if (hasOpenBlock) {
+                    openBlock = doc.blocks.back();
+                    openLanguage.assign(openBlock.language);
+                    openBlock.language = openLanguage;
+                }
+            }
+        }
+        arena.reset();
+        if (!rendered) {
+            windowSize *= 2;
+            continue;
+        }
+
+        out.write(html.data(), static_cast<std::streamsize>(html.size()));
+        html.clear();
+        window.erase(0, cut);
+        windowSize = bufferSize;
+
+        if (atEnd) break;
     }
 
-    return i > 0 && i <= 6 && i < line.length() && line[i] == ' ';
+    blockCache = savedCache;
 }
 
-bool MarkdownParser::isListItem(const std::string& line) {
-    std::string trimmedLine = trim(line);
-    if (trimmedLine.empty()) return false;
+std::string MarkdownParser::readTitle(std::istream& in) {
+    // Same rule as parseDocument
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.length() > 2 && line[0] == '#' && line[1] == ' ') {
+            return line.substr(2);
+        }
+    }
+    return "Untitled";
+}
+
+void MarkdownParser::renderBlock(const MarkdownDocument& doc, const MarkdownBlock& block,
+                                 const std::pmr::string* anchorId, std::string& out) {
+    switch (block.type) {
+        case BLOCK_PARAGRAPH:
+            parseParagraph(doc, block, out);
+            break;
+
+        case BLOCK_HEADING:
+            parseHeaders(doc.lines[block.firstLine], *anchorId, out);
+            out += '\n';
+            break;
+
+        case BLOCK_LIST:
+            if (!block.continued) out += block.ordered ? "<ol>\n" : "<ul>\n";
+            for (size_t i = 0; i < block.lineCount; i++) {
+                parseListItem(doc.lines[block.firstLine + i], out);
+                out += '\n';
+            }
+            if (!block.unfinished) out += block.ordered ? "</ol>\n" : "</ul>\n";
+            break;
 
-    if (trimmedLine[0] == '-' || trimmedLine[0] == '*') {
-        return trimmedLine.length() > 1 && trimmedLine[1] == ' ';
+        case BLOCK_CODE:
+            parseCodeBlock(doc, block, out);
+            break;
+
+        case BLOCK_TABLE:
+            parseTable(doc, block, out);
+            break;
     }
+}
 
-    if (std::isdigit(trimmedLine[0])) {
-        size_t dotPos = trimmedLine.find('.');
-        return dotPos != std::string::npos && dotPos < trimmedLine.length() - 1;
+// Hash of everything a block's HTML depends on: its source lines, its type
+// and flags, a code block's language and a heading's anchor
+CacheKey MarkdownParser::blockKey(const MarkdownDocument& doc, const MarkdownBlock& block,
+                                  const std::pmr::string* anchorId) {
+    CacheKey key;
+    key.mixText(blockSource(doc, block));
+    key.mix(block.type);
+    key.mix(block.ordered);
+    key.mix(block.closed);
+    key.mixText(block.language);
+    if (anchorId) {
+        key.mixText(*anchorId);
     }
+    return key;
+}
 
-    return false;
+void MarkdownParser::parseHeaders(std::string_view line, std::string_view anchorId, std::string& out) {
+    LineInfo info = classifyLine(line);
+    char levelDigit = static_cast<char>('0' + info.level);
+
+    out += "<h";
+    out += levelDigit;
+    out += " id=\"";
+    out += anchorId;
+    out += "\">";
+    parseInline(info.content(line), out);
+    out += "</h";
+    out += levelDigit;
+    out += '>';
 }
 
-bool MarkdownParser::isCodeBlockDelimiter(const std::string& line) {
-    std::string trimmedLine = trim(line);
-    return trimmedLine.find("```") == 0;
+void MarkdownParser::parseInline(std::string_view line, std::string& out) {
+    inlineRenderer.render(line, out);
 }
 
-bool MarkdownParser::isEmptyLine(const std::string& line) {
-    return trim(line).empty();
+void MarkdownParser::parseListItem(std::string_view line, std::string& out) {
+    out += "  <li>";
+    parseInline(classifyLine(line).content(line), out);
+    out += "</li>";
 }
 
-std::string MarkdownParser::trim(const std::string& str) {
-    size_t first = str.find_first_not_of(" \t\r\n");
-    if (first == std::string::npos) return "";
+void MarkdownParser::parseCodeBlock(const MarkdownDocument& doc, const MarkdownBlock& block, std::string& out) {
+    // An unterminated fence at the end of the file is still emitted
+    if (!block.closed && block.lineCount == 0 && !block.continued) return;
 
-    size_t last = str.find_last_not_of(" \t\r\n");
-    return str.substr(first, (last - first + 1));
-}
+    if (!block.continued) appendCodeBlockStart(block.language, out);
 
-std::string MarkdownParser::escapeHTML(const std::string& str) {
-    std::string result;
-    for (char c : str) {
-        switch (c) {
-            case '<': result += "&lt;"; break;
-            case '>': result += "&gt;"; break;
-            case '&': result += "&amp;"; break;
-            case '"': result += "&quot;"; break;
-            case '\'': result += "&#39;"; break;
-            default: result += c;
-        }
+    // Highlight at build time; unknown languages are only escaped. A block
+    // cut by renderStream is highlighted a piece at a time.
+    std::string_view code = blockSource(doc, block);
+    if (!highlightCode(code, highlightLanguage(block.language), out)) {
+        escapeHTML(code, out);
     }
-    return result;
-}
+    if (block.lineCount > 0) {
+        out += '\n';
+    }
+    if (block.unfinished) return;
+    out += "</code></pre>";
 
-bool MarkdownParser::isTableRow(const std::string& line) {
-    std::string trimmedLine = trim(line);
-    if (trimmedLine.empty()) return false;
+    if (!block.closed) {
+        out += '\n';
+    }
+}
 
-    // A table row starts and ends with |
-    if (trimmedLine[0] == '|' && trimmedLine.find('|', 1) != std::string::npos) {
-        return true;
+void MarkdownParser::parseParagraph(const MarkdownDocument& doc, const MarkdownBlock& block, std::string& out) {
+    if (!block.continued) out += "<p>";
+    for (size_t i = 0; i < block.lineCount; i++) {
+        if (i > 0 || block.continued) out += ' ';
+        parseInline(doc.lines[block.firstLine + i], out);
     }
+    if (!block.unfinished) out += "</p>\n";
+}
 
-    return false;
+std::string_view MarkdownParser::trim(std::string_view str) {
+    size_t first = str.find_first_not_of(" \t\r\n");
+    if (first == std::string_view::npos) return std::string_view();
+
+    size_t last = str.find_last_not_of(" \t\r\n");
+    return str.substr(first, (last - first + 1));
 }
 
-bool MarkdownParser::isTableDelimiter(const std::string& line) {
-    std::string trimmedLine = trim(line);
-    if (!isTableRow(trimmedLine)) return false;
+bool MarkdownParser::isTableDelimiter(std::string_view line) {
+    LineInfo info = classifyLine(line);
+    if (info.kind != LINE_TABLE_ROW) return false;
 
     // Check if the line contains only |, -, and spaces
-    for (char c : trimmedLine) {
+    for (char c : info.content(line)) {
         if (c != '|' && c != '-' && c != ' ' && c != ':') {
             return false;
         }
@@ -367,78 +619,136 @@ bool MarkdownParser::isTableDelimiter(const std::string& line) {
     return true;
 }
 
-std::vector<std::string> MarkdownParser::splitTableRow(const std::string& line) {
-    std::vector<std::string> cells;
-    std::string trimmedLine = trim(line);
+void MarkdownParser::splitTableRow(std::string_view line, std::vector<std::string_view>& cells) {
+    cells.clear();
+    std::string_view row = trim(line);
 
-    // Remove leading and trailing |
-    if (!trimmedLine.empty() && trimmedLine[0] == '|') {
-        trimmedLine = trimmedLine.substr(1);
+    // Remove leading and trailing | (an escaped \| at the end stays)
+    if (!row.empty() && row[0] == '|') {
+        row.remove_prefix(1);
     }
-    if (!trimmedLine.empty() && trimmedLine.back() == '|') {
-        trimmedLine = trimmedLine.substr(0, trimmedLine.length() - 1);
+    if (!row.empty() && row.back() == '|' && !(row.length() > 1 && row[row.length() - 2] == '\\')) {
+        row.remove_suffix(1);
     }
 
-    // Split by |
-    std::stringstream ss(trimmedLine);
-    std::string cell;
-
-    while (std::getline(ss, cell, '|')) {
-        cells.push_back(trim(cell));
+    // Split on | outside code spans, skipping escaped \| (like std::getline,
+    // a trailing separator adds no empty cell)
+    size_t start = 0;
+    size_t i = 0;
+    while (i < row.length()) {
+        char c = row[i];
+        if (c == '\\' && i + 1 < row.length()) {
+            i += 2;
+            continue;
+        }
+        if (c == '`') {
+            size_t close = row.find('`', i + 1);
+            if (close != std::string_view::npos) {
+                i = close + 1;
+                continue;
+            }
+        }
+        if (c == '|') {
+            cells.push_back(trim(row.substr(start, i - start)));
+            start = i + 1;
+        }
+        i++;
     }
+    if (start < row.length()) {
+        cells.push_back(trim(row.substr(start)));
+    }
+}
 
-    return cells;
+// Column alignment from the delimiter row: :--- left, ---: right, :---: center
+void MarkdownParser::parseTableAlignments(std::string_view delimiterRow) {
+    splitTableRow(delimiterRow, tableCells);
+    tableAlignments.clear();
+
+    for (const auto& cell : tableCells) {
+        bool left = !cell.empty() && cell.front() == ':';
+        bool right = !cell.empty() && cell.back() == ':';
+        if (left && right) {
+            tableAlignments.push_back(" style=\"text-align: center\"");
+        } else if (left) {
+            tableAlignments.push_back(" style=\"text-align: left\"");
+        } else if (right) {
+            tableAlignments.push_back(" style=\"text-align: right\"");
+        } else {
+            tableAlignments.push_back("");
+        }
+    }
 }
 
-std::string MarkdownParser::parseTable(std::vector<std::string>& tableLines) {
-    if (tableLines.empty()) return "";
+void MarkdownParser::parseTableCell(std::string_view cell, const char* tag, size_t column, std::string& out) {
+    out += "      <";
+    out += tag;
+    if (column < tableAlignments.size()) {
+        out += tableAlignments[column];
+    }
+    out += '>';
 
-    std::stringstream html;
-    html << "<table>\n";
+    // An escaped pipe renders as a plain |
+    if (cell.find("\\|") == std::string_view::npos) {
+        parseInline(cell, out);
+    } else {
+        tableCellText.clear();
+        for (size_t i = 0; i < cell.length(); i++) {
+            if (cell[i] == '\\' && i + 1 < cell.length() && cell[i + 1] == '|') continue;
+            tableCellText += cell[i];
+        }
+        parseInline(tableCellText, out);
+    }
 
+    out += "</";
+    out += tag;
+    out += ">\n";
+}
+
+// Rows are rendered straight from the source lines, one at a time
+void MarkdownParser::parseTable(const MarkdownDocument& doc, const MarkdownBlock& block, std::string& out) {
+    if (block.lineCount == 0 && !block.continued) return;
+
+    const std::string_view* tableLines = doc.lines.data() + block.firstLine;
     bool hasHeader = false;
 
-    // Check if the second line is a delimiter (indicating header row)
-    if (tableLines.size() > 1 && isTableDelimiter(tableLines[1])) {
-        hasHeader = true;
-    }
+    // A table continued from the previous stream window keeps its alignments
+    // and only adds body rows
+    if (!block.continued) {
+        out += "<table>\n";
+        tableAlignments.clear();
+
+        // Check if the second line is a delimiter (indicating header row)
+        if (block.lineCount > 1 && isTableDelimiter(tableLines[1])) {
+            hasHeader = true;
+            parseTableAlignments(tableLines[1]);
+        }
 
-    // Parse header if present
-    if (hasHeader) {
-        html << "  <thead>\n    <tr>\n";
-        std::vector<std::string> cells = splitTableRow(tableLines[0]);
-        for (const auto& cell : cells) {
-            std::string processedCell = cell;
-            processedCell = parseImages(processedCell);
-            processedCell = parseBold(processedCell);
-            processedCell = parseItalic(processedCell);
-            processedCell = parseLinks(processedCell);
-            processedCell = parseInlineCode(processedCell);
-            html << "      <th>" << processedCell << "</th>\n";
-        }
-        html << "    </tr>\n  </thead>\n";
+        // Parse header if present
+        if (hasHeader) {
+            out += "  <thead>\n    <tr>\n";
+            splitTableRow(tableLines[0], tableCells);
+            for (size_t column = 0; column < tableCells.size(); column++) {
+                parseTableCell(tableCells[column], "th", column, out);
+            }
+            out += "    </tr>\n  </thead>\n";
+        }
+
+        out += "  <tbody>\n";
     }
 
     // Parse body rows
-    html << "  <tbody>\n";
-    for (size_t i = (hasHeader ? 2 : 0); i < tableLines.size(); i++) {
+    for (size_t i = (hasHeader ? 2 : 0); i < block.lineCount; i++) {
         if (isTableDelimiter(tableLines[i])) continue;
 
-        html << "    <tr>\n";
-        std::vector<std::string> cells = splitTableRow(tableLines[i]);
-        for (const auto& cell : cells) {
-            std::string processedCell = cell;
-            processedCell = parseImages(processedCell);
-            processedCell = parseBold(processedCell);
-            processedCell = parseItalic(processedCell);
-            processedCell = parseLinks(processedCell);
-            processedCell = parseInlineCode(processedCell);
-            html << "      <td>" << processedCell << "</td>\n";
-        }
-        html << "    </tr>\n";
+        out += "    <tr>\n";
+        splitTableRow(tableLines[i], tableCells);
+        for (size_t column = 0; column < tableCells.size(); column++) {
+            parseTableCell(tableCells[column], "td", column, out);
+        }
+        out += "    </tr>\n";
     }
-    html << "  </tbody>\n";
+    if (block.unfinished) return;
+    out += "  </tbody>\n";
 
-    html << "</table>\n";
-    return html.str();
+    out += "</table>\n";
 }
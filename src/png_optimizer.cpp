@@ -0,0 +1,391 @@
+#include "png_optimizer.h"
+#include "hash.h"
+#include "image_store.h"
+#include "thread_pool.h"
+#include <zlib.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char PNG_SIGNATURE[] = "\x89PNG\r\n\x1a\n";
+const size_t SIGNATURE_SIZE = 8;
+
+// Larger images are left alone rather than decoded in memory
+const uint64_t MAX_IMAGE_BYTES = 256 * 1024 * 1024;
+
+// PNG filter types, plus the per-row choice
+enum Filter { FILTER_NONE, FILTER_SUB, FILTER_UP, FILTER_AVERAGE, FILTER_PAETH, FILTER_COUNT };
+const int FILTER_ADAPTIVE = FILTER_COUNT;
+
+struct Chunk {
+    std::string_view type;
+    std::string_view data;
+};
+
+struct ImageLayout {
+    size_t rowBytes;   // bytes per scanline, without the filter type byte
+    size_t pixelBytes; // distance to the same byte of the pixel on the left
+    size_t height;
+};
+
+uint32_t readUint32(const char* bytes) {
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(bytes);
+    return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | uint32_t(b[3]);
+}
+
+void appendUint32(std::string& out, uint32_t value) {
+    out += static_cast<char>(value >> 24);
+    out += static_cast<char>(value >> 16);
+    out += static_cast<char>(value >> 8);
+    out += static_cast<char>(value);
+}
+
+uLong chunkCRC(std::string_view type, std::string_view data) {
+    uLong crc = crc32(0, reinterpret_cast<const Bytef*>(type.data()), type.size());
+    return crc32(crc, reinterpret_cast<const Bytef*>(data.data()), data.size());
+}
+
+void appendChunk(std::string& out, std::string_view type, std::string_view data) {
+    appendUint32(out, static_cast<uint32_t>(data.size()));
+    out.append(type);
+    out.append(data);
+    appendUint32(out, static_cast<uint32_t>(chunkCRC(type, data)));
+}
+
+// Split a PNG into its chunks up to IEND; false if the signature, a length
+// or a CRC is wrong
+bool readChunks(std::string_view input, std::vector<Chunk>& chunks) {
+    if (input.substr(0, SIGNATURE_SIZE) != std::string_view(PNG_SIGNATURE, SIGNATURE_SIZE)) return false;
+
+    size_t pos = SIGNATURE_SIZE;
+    while (input.size() - pos >= 12) {
+        uint32_t length = readUint32(input.data() + pos);
+        if (length > input.size() - pos - 12) return false;
+
+        Chunk chunk{input.substr(pos + 4, 4), input.substr(pos + 8, length)};
+        if (chunkCRC(chunk.type, chunk.data) != readUint32(input.data() + pos + 8 + length)) return false;
+        chunks.push_back(chunk);
+        pos += 12 + length;
+        if (chunk.type == "IEND") return true;
+    }
+    return false;
+}
+
+bool isCritical(std::string_view type) {
+    return (type[0] & 0x20) == 0;
+}
+
+// Ancillary chunks that change how the image looks: transparency and color
+// space. Text, time stamps, physical size, background color and the rest go.
+bool keepAncillary(std::string_view type) {
+    return type == "tRNS" || type == "gAMA" || type == "cHRM" || type == "sRGB" || type == "iCCP";
+}
+
+// Scanline layout from the IHDR chunk; false for interlaced images and for
+// color type and bit depth combinations the format does not allow
+bool readLayout(std::string_view header, ImageLayout& layout) {
+    if (header.size() != 13) return false;
+    uint64_t width = readUint32(header.data());
+    uint64_t height = readUint32(header.data() + 4);
+    unsigned bitDepth = static_cast<unsigned char>(header[8]);
+    unsigned colorType = static_cast<unsigned char>(header[9]);
+    if (width == 0 || height == 0 || header[10] != 0 || header[11] != 0 || header[12] != 0) return false;
+
+    bool lowDepth = bitDepth == 1 || bitDepth == 2 || bitDepth == 4;
+    bool byteDepth = bitDepth == 8 || bitDepth == 16;
+    unsigned channels = 0;
+    switch (colorType) {
+        case 0: channels = 1; if (!lowDepth && !byteDepth) return false; break;
+        case 2: channels = 3; if (!byteDepth) return false; break;
+        case 3: channels = 1; if (!lowDepth && bitDepth != 8) return false; break;
+        case 4: channels = 2; if (!byteDepth) return false; break;
+        case 6: channels = 4; if (!byteDepth) return false; break;
+        default: return false;
+    }
+
+    uint64_t bitsPerPixel = channels * bitDepth;
+    uint64_t rowBytes = (width * bitsPerPixel + 7) / 8;
+    if (rowBytes >= MAX_IMAGE_BYTES || (rowBytes + 1) * height > MAX_IMAGE_BYTES) return false;
+
+    layout.rowBytes = static_cast<size_t>(rowBytes);
+    layout.pixelBytes = bitsPerPixel < 8 ? 1 : static_cast<size_t>(bitsPerPixel / 8);
+    layout.height = static_cast<size_t>(height);
+    return true;
+}
+
+unsigned char paeth(int left, int up, int upLeft) {
+    int estimate = left + up - upLeft;
+    int toLeft = std::abs(estimate - left);
+    int toUp = std::abs(estimate - up);
+    int toUpLeft = std::abs(estimate - upLeft);
+    if (toLeft <= toUp && toLeft <= toUpLeft) return static_cast<unsigned char>(left);
+    if (toUp <= toUpLeft) return static_cast<unsigned char>(up);
+    return static_cast<unsigned char>(upLeft);
+}
+
+// What filter predicts for byte i of row, given the unfiltered row above
+unsigned char predict(int filter, const unsigned char* row, const unsigned char* above, size_t i,
+                      size_t pixelBytes) {
+    int left = i >= pixelBytes ? row[i - pixelBytes] : 0;
+    int up = above[i];
+    int upLeft = i >= pixelBytes ? above[i - pixelBytes] : 0;
+    switch (filter) {
+        case FILTER_SUB: return static_cast<unsigned char>(left);
+        case FILTER_UP: return static_cast<unsigned char>(up);
+        case FILTER_AVERAGE: return static_cast<unsigned char>((left + up) / 2);
+        case FILTER_PAETH: return paeth(left, up, upLeft);
+        default: return 0;
+    }
+}
+
+// Undo the filter of every scanline into rows (the raw scanlines back to
+// back); false for an unknown filter type
+bool unfilterImage(const std::string& filtered, const ImageLayout& layout, std::string& rows) {
+    rows.assign(layout.rowBytes * layout.height, '\0');
+    std::vector<unsigned char> zeros(layout.rowBytes);
+
+    for (size_t y = 0; y < layout.height; y++) {
+        const unsigned char* source = reinterpret_cast<const unsigned char*>(&filtered[y * (layout.rowBytes + 1)]);
+        unsigned char* row = reinterpret_cast<unsigned char*>(&rows[y * layout.rowBytes]);
+        const unsigned char* above = y > 0 ? row - layout.rowBytes : zeros.data();
+
+        int filter = source[0];
+        if (filter >= FILTER_COUNT) return false;
+        for (size_t i = 0; i < layout.rowBytes; i++) {
+            row[i] = static_cast<unsigned char>(source[i + 1] + predict(filter, row, above, i, layout.pixelBytes));
+        }
+    }
+    return true;
+}
+
+// Append one scanline filtered with filter; returns the sum of the filtered
+// bytes taken as signed differences
+size_t filterRow(int filter, const unsigned char* row, const unsigned char* above, const ImageLayout& layout,
+                 std::string& out) {
+    size_t cost = 0;
+    out += static_cast<char>(filter);
+    for (size_t i = 0; i < layout.rowBytes; i++) {
+        unsigned char value = static_cast<unsigned char>(row[i] - predict(filter, row, above, i, layout.pixelBytes));
+        out += static_cast<char>(value);
+        cost += value < 128 ? value : 256 - value;
+    }
+    return cost;
+}
+
+// Filter every scanline with filter, or with FILTER_ADAPTIVE pick for each
+// row the filter with the smallest sum of absolute differences (the
+// heuristic libpng uses)
+std::string filterImage(const std::string& rows, const ImageLayout& layout, int filter) {
+    std::string filtered;
+    filtered.reserve((layout.rowBytes + 1) * layout.height);
+    std::vector<unsigned char> zeros(layout.rowBytes);
+    std::string bestRow;
+    std::string candidateRow;
+
+    for (size_t y = 0; y < layout.height; y++) {
+        const unsigned char* row = reinterpret_cast<const unsigned char*>(&rows[y * layout.rowBytes]);
+        const unsigned char* above = y > 0 ? row - layout.rowBytes : zeros.data();
+
+        if (filter != FILTER_ADAPTIVE) {
+            filterRow(filter, row, above, layout, filtered);
+            continue;
+        }
+
+        size_t bestCost = SIZE_MAX;
+        for (int candidate = FILTER_NONE; candidate < FILTER_COUNT; candidate++) {
+            candidateRow.clear();
+            size_t cost = filterRow(candidate, row, above, layout, candidateRow);
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestRow.swap(candidateRow);
+            }
+        }
+        filtered += bestRow;
+    }
+    return filtered;
+}
+
+// zlib stream of data at the given compression level
+bool deflateData(const std::string& data, int level, int strategy, std::string& out) {
+    z_stream stream{};
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15, 9, strategy) != Z_OK) return false;
+
+    out.resize(deflateBound(&stream, data.size()));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+
+    int result = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+
+std::string readBytes(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+} // namespace
+
+bool recompressPNG(std::string_view input, std::string& output) {
+    std::vector<Chunk> chunks;
+    ImageLayout layout;
+    if (!readChunks(input, chunks) || chunks[0].type != "IHDR" || !readLayout(chunks[0].data, layout)) {
+        return false;
+    }
+
+    // Animated PNGs keep their other frames in fdAT chunks, which this
+    // does not re-encode, and an unknown critical chunk cannot be dropped
+    std::string compressed;
+    for (const auto& chunk : chunks) {
+        if (chunk.type == "IDAT") {
+            compressed.append(chunk.data);
+        } else if (chunk.type == "acTL") {
+            return false;
+        } else if (isCritical(chunk.type) && chunk.type != "IHDR" && chunk.type != "PLTE" && chunk.type != "IEND") {
+            return false;
+        }
+    }
+
+    std::string filtered((layout.rowBytes + 1) * layout.height, '\0');
+    uLongf filteredSize = filtered.size();
+    if (compressed.empty() ||
+        uncompress(reinterpret_cast<Bytef*>(&filtered[0]), &filteredSize,
+                   reinterpret_cast<const Bytef*>(compressed.data()), compressed.size()) != Z_OK ||
+        filteredSize != filtered.size()) {
+        return false;
+    }
+
+    std::string rows;
+    if (!unfilterImage(filtered, layout, rows)) return false;
+
+    // Candidate filterings: the original one, each filter type for every
+    // row, and the per-row choice
+    std::vector<std::string> filterings;
+    filterings.push_back(std::move(filtered));
+    for (int filter = FILTER_NONE; filter <= FILTER_ADAPTIVE; filter++) {
+        std::string data = filterImage(rows, layout, filter);
+        if (data != filterings[0]) filterings.push_back(std::move(data));
+    }
+
+    // Maximum compression costs ten times as much as the fastest level,
+    // which ranks the filterings about the same way, so only the two that
+    // come out smallest at the fastest level get it, with both zlib
+    // strategies that suit image data
+    std::string candidate;
+    std::vector<std::pair<size_t, size_t>> ranking; // fast size, filtering
+    for (size_t i = 0; i < filterings.size(); i++) {
+        if (deflateData(filterings[i], Z_BEST_SPEED, Z_DEFAULT_STRATEGY, candidate)) {
+            ranking.push_back({candidate.size(), i});
+        }
+    }
+    std::sort(ranking.begin(), ranking.end());
+    if (ranking.size() > 2) ranking.resize(2);
+
+    std::string best;
+    for (const auto& ranked : ranking) {
+        for (int strategy : {Z_DEFAULT_STRATEGY, Z_FILTERED}) {
+            if (deflateData(filterings[ranked.second], Z_BEST_COMPRESSION, strategy, candidate) &&
+                (best.empty() || candidate.size() < best.size())) {
+                best.swap(candidate);
+            }
+        }
+    }
+    if (best.empty()) return false;
+
+    std::string result(PNG_SIGNATURE, SIGNATURE_SIZE);
+    bool wroteData = false;
+    for (const auto& chunk : chunks) {
+        if (chunk.type == "IDAT") {
+            if (!wroteData) appendChunk(result, "IDAT", best);
+            wroteData = true;
+        } else if (isCritical(chunk.type) || keepAncillary(chunk.type)) {
+            appendChunk(result, chunk.type, chunk.data);
+        }
+    }
+
+    if (result.size() >= input.size()) return false;
+    output.swap(result);
+    return true;
+}
+
+PNGOptimizeStats optimizePNGImages(const std::string& directory, std::unordered_set<uint64_t>& optimized) {
+    PNGOptimizeStats stats;
+    std::vector<std::string> names;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(directory, error)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".png") {
+            names.push_back(entry.path().filename().string());
+        }
+    }
+
+    struct Result {
+        bool done = false; // hash can be recorded
+        bool cached = false;
+        bool recompressed = false;
+        uint64_t hash = 0; // of the file as it is now
+        size_t before = 0;
+        size_t after = 0;
+    };
+    std::vector<Result> results(names.size());
+    ImageStore store(directory);
+
+    // Tasks only read the set of optimized hashes; it is rebuilt afterwards
+    ThreadPool::shared().parallelFor(names.size(), [&](size_t i) {
+        Result& result = results[i];
+        std::string bytes = readBytes(fs::path(directory) / names[i]);
+        if (bytes.empty()) {
+            std::cerr << "Error reading image: " << names[i] << std::endl;
+            return;
+        }
+        result.done = true;
+        result.hash = hashBytes(bytes);
+        if (optimized.count(result.hash)) {
+            result.cached = true;
+            return;
+        }
+
+        // A file that cannot be made smaller is recorded too, so it is not
+        // tried again
+        std::string smaller;
+        if (!recompressPNG(bytes, smaller)) return;
+        try {
+            store.replace(names[i], smaller);
+        } catch (const std::exception& e) {
+            std::cerr << "Error writing optimized image " << names[i] << ": " << e.what() << std::endl;
+            result.done = false; // try again next build
+            return;
+        }
+        result.recompressed = true;
+        result.hash = hashBytes(smaller);
+        result.before = bytes.size();
+        result.after = smaller.size();
+    });
+
+    stats.files = names.size();
+    optimized.clear();
+    for (const auto& result : results) {
+        if (!result.done) continue;
+        optimized.insert(result.hash);
+        if (result.cached) stats.cached++;
+        if (result.recompressed) {
+            stats.recompressed++;
+            stats.bytesBefore += result.before;
+            stats.bytesAfter += result.after;
+        }
+    }
+    return stats;
+}
@@ -1,12 +1,13 @@
 #include "processor.h"
 #include "file_utils.h"
+#include "document_store.h"
 #include "metadata.h"
 #include "cache.h"
 #include "content_tree.h"
 #include "template.h"
 #include "toc.h"
-#include "jupyter_parser.h"
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <algorithm>
 
@@ -32,10 +33,10 @@ void processContentNode(ContentNode* node,
             fs::create_directories(outputDirPath);
         }
 
-        std::string fileContent = readFile(node->path);
-        if (fileContent.empty()) return;
+        const SourceFile& source = loadSourceFile(node->path);
+        if (source.size == 0) return;
 
-        bool needsRegen = needsBlogRegeneration(node->path, fileContent, outputPath, templateHash, cache);
+        bool needsRegen = needsBlogRegeneration(node->path, source.hash, outputPath, templateHash, cache);
 
         if (!needsRegen) {
             std::cout << "Skipping (up-to-date): " << node->outputPath << std::endl;
@@ -53,22 +54,11 @@ void processContentNode(ContentNode* node,
         std::string extension = filePath.extension().string();
 
         if (extension == ".ipynb") {
-            JupyterParser jupyterParser;
-            std::vector<std::string> extractedImages;
-            htmlContent = jupyterParser.convertToHTML(fileContent, node->path, extractedImages);
-
-            for (const auto& imagePath : extractedImages) {
-                fs::path imgPath(imagePath);
-                std::string destPath = "docs/images/notebooks/" + imgPath.filename().string();
-                try {
-                    fs::copy_file(imagePath, destPath, fs::copy_options::overwrite_existing);
-                } catch (const fs::filesystem_error& e) {
-                    std::cerr << "Error copying image: " << e.what() << std::endl;
-                }
-            }
+            htmlContent = renderNotebook(node->path);
         } else {
-            htmlContent = parser.convertToHTML(fileContent);
-            toc = generateTOC(fileContent);
+            const MarkdownDocument& document = sourceDocument(node->path);
+            htmlContent = parser.renderHTML(document);
+            toc = generateTOC(document);
         }
 
         // Calculate subdirectory depth
@@ -84,12 +74,14 @@ void processContentNode(ContentNode* node,
 
         // Update cache
         CachedMetadata metadata;
-        metadata.contentHash = hashString(fileContent + templateHash);
+        metadata.contentHash = pageHash(source.hash, templateHash);
         metadata.publishDate = node->publishDate;
         metadata.timestamp = node->timestamp;
         metadata.fileModTime = getFileModificationTimestamp(node->path);
         newCache[node->path] = metadata;
 
+        releaseSourceFile(node->path);
+
     } else if (node->type == NODE_DIRECTORY) {
         for (ContentNode* child : node->children) {
             processContentNode(child, outputBaseDir, templateContent, parser,
@@ -119,8 +111,8 @@ void processCategoryBlogs(const std::string& categoryDir, const std::string& cat
         std::string filename = fileNode->name;
         std::string outputPath = "docs/" + fileNode->outputPath;
 
-        std::string markdownContent = readFile(filepath);
-        if (markdownContent.empty()) continue;
+        const SourceFile& source = loadSourceFile(filepath);
+        if (source.size == 0) continue;
 
         std::string title = fileNode->title;
         std::string excerpt = fileNode->excerpt;
@@ -151,7 +143,7 @@ void processCategoryBlogs(const std::string& categoryDir, const std::string& cat
 
         // Update cache
         CachedMetadata metadata;
-        metadata.contentHash = hashString(markdownContent + templateHash);
+        metadata.contentHash = pageHash(source.hash, templateHash);
         metadata.publishDate = publishDate;
         metadata.timestamp = timestamp;
         metadata.fileModTime = getFileModificationTimestamp(filepath);
@@ -160,3 +152,32 @@ void processCategoryBlogs(const std::string& categoryDir, const std::string& cat
 
     freeContentTree(categoryTree);
 }
+
+bool streamMarkdownPage(const std::string& sourcePath, const std::string& outputPath,
+                        const std::string& templateContent, const std::string& title,
+                        const std::vector<Page>& pages, int subdirectoryDepth,
+                        MarkdownParser& parser, size_t bufferSize) {
+    std::ifstream in(sourcePath);
+    if (!in.is_open()) {
+        std::cerr << "Error: Could not open file " << sourcePath << std::endl;
+        return false;
+    }
+
+    std::ofstream out(outputPath);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not write to file " << outputPath << std::endl;
+        return false;
+    }
+
+    std::string head;
+    std::string tail;
+    applyTemplateParts(templateContent, title, pages, subdirectoryDepth, "", head, tail);
+
+    out << head;
+    parser.renderStream(in, out, bufferSize);
+    out << tail;
+    out.close();
+
+    std::cout << "Generated: " << outputPath << std::endl;
+    return true;
+}
@@ -0,0 +1,70 @@
+#include "slug.h"
+#include <array>
+#include <charconv>
+
+namespace {
+
+// What each byte becomes in a slug; 0 drops it
+constexpr std::array<char, 256> buildSlugChars() {
+    std::array<char, 256> table{};
+    for (int c = 'a'; c <= 'z'; c++) {
+        table[c] = static_cast<char>(c);
+    }
+    for (int c = 'A'; c <= 'Z'; c++) {
+        table[c] = static_cast<char>(c - 'A' + 'a');
+    }
+    for (int c = '0'; c <= '9'; c++) {
+        table[c] = static_cast<char>(c);
+    }
+    table[' '] = '-';
+    table['-'] = '-';
+    return table;
+}
+
+constexpr std::array<char, 256> SLUG_CHARS = buildSlugChars();
+
+template <typename String>
+void appendSlug(std::string_view text, String& slug) {
+    slug.reserve(slug.length() + text.length());
+    for (char c : text) {
+        char mapped = SLUG_CHARS[static_cast<unsigned char>(c)];
+        if (mapped) {
+            slug += mapped;
+        }
+    }
+}
+
+} // namespace
+
+std::string slugify(std::string_view text) {
+    std::string slug;
+    appendSlug(text, slug);
+    return slug;
+}
+
+SlugGenerator::SlugGenerator(std::pmr::memory_resource* resource)
+    : used(resource), lastSuffix(resource) {}
+
+std::pmr::string SlugGenerator::next(std::string_view text) {
+    std::pmr::string slug(used.get_allocator());
+    appendSlug(text, slug);
+    if (used.insert(slug).second) {
+        return slug;
+    }
+
+    // Continue from the last suffix handed out for this slug
+    int& suffix = lastSuffix[slug];
+    std::pmr::string candidate(used.get_allocator());
+    while (true) {
+        suffix++;
+        char digits[16];
+        char* digitsEnd = std::to_chars(digits, digits + sizeof(digits), suffix).ptr;
+
+        candidate.assign(slug);
+        candidate += '-';
+        candidate.append(digits, digitsEnd);
+        if (used.insert(candidate).second) {
+            return candidate;
+        }
+    }
+}
@@ -3,28 +3,44 @@
 #include <vector>
 #include <utility>
 
-std::string applyTemplate(const std::string& templateContent, const std::string& title,
-                          const std::string& content, const std::vector<Page>& pages,
-                          int subdirectoryDepth, const std::string& toc) {
-    std::string result = templateContent;
+namespace {
 
-    // Replace title placeholder
-    size_t pos = result.find("{{TITLE}}");
+void replaceAll(std::string& text, const std::string& placeholder, const std::string& value) {
+    size_t pos = text.find(placeholder);
     while (pos != std::string::npos) {
-        result.replace(pos, 9, title);
-        pos = result.find("{{TITLE}}", pos + title.length());
+        text.replace(pos, placeholder.length(), value);
+        pos = text.find(placeholder, pos + value.length());
     }
+}
 
-    // Replace content placeholder
-    pos = result.find("{{CONTENT}}");
-    if (pos != std::string::npos) {
-        result.replace(pos, 11, content);
-    }
+} // namespace
+
+std::string applyTemplate(const std::string& templateContent, const std::string& title,
+                          const std::string& content, const std::vector<Page>& pages,
+                          int subdirectoryDepth, const std::string& toc) {
+    std::string head;
+    std::string tail;
+    applyTemplateParts(templateContent, title, pages, subdirectoryDepth, toc, head, tail);
+
+    std::string result;
+    result.reserve(head.length() + content.length() + tail.length());
+    result += head;
+    result += content;
+    result += tail;
+    return result;
+}
 
-    // Replace TOC placeholder
-    pos = result.find("{{TOC}}");
-    if (pos != std::string::npos) {
-        result.replace(pos, 7, toc);
+void applyTemplateParts(const std::string& templateContent, const std::string& title,
+                        const std::vector<Page>& pages, int subdirectoryDepth, const std::string& toc,
+                        std::string& head, std::string& tail) {
+    // Split at the content placeholder; content is never scanned for placeholders
+    size_t slot = templateContent.find("{{CONTENT}}");
+    if (slot == std::string::npos) {
+        head = templateContent;
+        tail.clear();
+    } else {
+        head = templateContent.substr(0, slot);
+        tail = templateContent.substr(slot + 11);
     }
 
     // Replace CSS path placeholder - handle different subdirectory depths
@@ -32,11 +48,6 @@ std::string applyTemplate(const std::string& templateContent, const std::string&
     for (int i = 0; i < subdirectoryDepth; i++) {
         cssPath += "../";
     }
-    pos = result.find("{{CSS_PATH}}");
-    while (pos != std::string::npos) {
-        result.replace(pos, 12, cssPath);
-        pos = result.find("{{CSS_PATH}}", pos + cssPath.length());
-    }
 
     // Generate navigation - only show main pages in specific order
     std::stringstream nav;
@@ -58,10 +69,38 @@ std::string applyTemplate(const std::string& templateContent, const std::string&
         nav << "<a href=\"" << item.first << "\">" << item.second << "</a>";
     }
 
-    pos = result.find("{{NAV}}");
-    if (pos != std::string::npos) {
-        result.replace(pos, 7, nav.str());
+    for (std::string* part : {&head, &tail}) {
+        replaceAll(*part, "{{TITLE}}", title);
+        replaceAll(*part, "{{TOC}}", toc);
+        replaceAll(*part, "{{CSS_PATH}}", cssPath);
+        replaceAll(*part, "{{NAV}}", nav.str());
+    }
+}
+
+std::string stripClientHighlighting(const std::string& templateContent) {
+    const std::string beginMarker = "<!-- CLIENT_HIGHLIGHT_BEGIN";
+    const std::string endMarker = "<!-- CLIENT_HIGHLIGHT_END -->";
+
+    std::string result;
+    size_t copied = 0;
+    size_t begin = templateContent.find(beginMarker);
+    while (begin != std::string::npos) {
+        size_t end = templateContent.find(endMarker, begin);
+        if (end == std::string::npos) break;
+
+        // Drop the whole section, including the indentation before it and
+        // the newline after it
+        size_t lineStart = begin == 0 ? std::string::npos : templateContent.find_last_not_of(" \t", begin - 1);
+        lineStart = lineStart == std::string::npos ? 0 : lineStart + 1;
+        result.append(templateContent, copied, lineStart - copied);
+
+        copied = end + endMarker.length();
+        if (copied < templateContent.length() && templateContent[copied] == '\n') {
+            copied++;
+        }
+        begin = templateContent.find(beginMarker, copied);
     }
 
+    result.append(templateContent, copied, std::string::npos);
     return result;
 }
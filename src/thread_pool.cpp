@@ -0,0 +1,115 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace {
+
+// One parallelFor call. Helpers that start after every index has been
+// claimed return without touching the task, so only the counters and the
+// shared pointer have to outlive the call.
+struct ParallelForState {
+    const std::function<void(size_t)>* task;
+    size_t count;
+    std::atomic<size_t> next;
+    std::atomic<size_t> done;
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::exception_ptr error;
+
+    ParallelForState(const std::function<void(size_t)>& task, size_t count)
+        : task(&task), count(count), next(0), done(0) {}
+};
+
+void runTasks(ParallelForState& state) {
+    while (true) {
+        size_t index = state.next.fetch_add(1);
+        if (index >= state.count) return;
+
+        try {
+            (*state.task)(index);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (!state.error) {
+                state.error = std::current_exception();
+            }
+        }
+
+        if (state.done.fetch_add(1) + 1 == state.count) {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.finished.notify_all();
+        }
+    }
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t threads) : stopping(false) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::concurrency() const {
+    return workers.size() + 1;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) return;
+
+    auto state = std::make_shared<ParallelForState>(task, count);
+    size_t helpers = std::min(workers.size(), count - 1);
+    if (helpers > 0) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < helpers; i++) {
+                jobs.push([state] { runTasks(*state); });
+            }
+        }
+        wake.notify_all();
+    }
+
+    runTasks(*state);
+
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&] { return state->done.load() == count; });
+    }
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+        job();
+    }
+}
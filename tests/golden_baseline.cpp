@@ -0,0 +1,53 @@
+// Golden file writer built against the baseline commit's markdown renderer
+// (the regex one the inline scanner replaced), not against this tree; see
+// make_golden.sh. Prints what test_golden compares a source file with: a
+// markdown file's table of contents and body, or the HTML of each markdown
+// cell of a notebook.
+
+#include "json.hpp"
+#include "markdown_parser.h"
+#include "toc.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using json = nlohmann::json;
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "usage: golden_baseline <file.md|file.ipynb>" << std::endl;
+        return 2;
+    }
+
+    std::string path = argv[1];
+    std::ifstream file(path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string content = buffer.str();
+
+    MarkdownParser parser;
+    if (path.size() < 6 || path.substr(path.size() - 6) != ".ipynb") {
+        std::cout << generateTOC(content) << parser.convertToHTML(content);
+        return 0;
+    }
+
+    // Cell sources are strings or lists of lines, joined as the notebook
+    // parser of the same commit joins them
+    json notebook = json::parse(content);
+    for (const auto& cell : notebook["cells"]) {
+        if (cell.value("cell_type", "") != "markdown") continue;
+
+        std::string source;
+        const json& lines = cell["source"];
+        if (lines.is_string()) {
+            source = lines.get<std::string>();
+        } else {
+            for (const auto& line : lines) {
+                if (line.is_string()) source += line.get<std::string>();
+            }
+        }
+        std::cout << parser.convertToHTML(source) << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+#!/bin/bash
+# Regenerate tests/golden/ with the markdown renderer of the baseline commit,
+# which test_golden holds the current renderer to. Output changed on purpose
+# since then is pinned in test_golden.cpp, not written here.
+# Usage: tests/make_golden.sh (from anywhere in the repository)
+
+set -e
+
+BASELINE=3849cfd
+
+ROOT=$(git rev-parse --show-toplevel)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+git -C "$ROOT" archive "$BASELINE" include src | tar -x -C "$WORK"
+${CXX:-c++} -std=c++17 -O1 -I"$WORK/include" "$ROOT/tests/golden_baseline.cpp" \
+    "$WORK/src/markdown_parser.cpp" "$WORK/src/toc.cpp" -o "$WORK/golden_baseline"
+
+cd "$ROOT"
+find content -type f \( -name '*.md' -o -name '*.ipynb' \) | while read -r source; do
+    golden="tests/golden/${source#content/}"
+    golden="${golden%.*}.html"
+    mkdir -p "$(dirname "$golden")"
+    "$WORK/golden_baseline" "$source" > "$golden"
+    echo "Generated: $golden"
+done
@@ -0,0 +1,168 @@
+// Heap allocations made while rendering markdown, counted by replacing the
+// global operator new. Once the parser's arena and scratch buffers have
+// grown, splitting lines and rendering must not allocate per line, so the
+// count for a page stays the same however long the page is.
+
+#include "arena.h"
+#include "line_iterator.h"
+#include "markdown_parser.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+
+// Every heap allocation in the process is counted
+namespace {
+std::atomic<size_t> allocationCount(0);
+}
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// std::pmr::new_delete_resource allocates through the aligned forms
+void* operator new(size_t size, std::align_val_t alignment) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+    void* p = std::aligned_alloc(align, (size + align - 1) / align * align);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what, size_t allocations) {
+    printf("%s %-58s %zu allocations\n", ok ? "ok  " : "FAIL", what, allocations);
+    if (!ok) failures++;
+}
+
+// A post with every kind of block, repeated sections times. Headings are
+// all the same text, so later ones get numbered anchors.
+std::string generatePage(int sections) {
+    std::string page = "# Title\n\nIntro with *emphasis*, **strong**, `code` and a [link](https://example.com).\n\n";
+    for (int i = 0; i < sections; i++) {
+        page += "## Section\n\n";
+        page += "A paragraph line with an intra_word underscore and ![an image](img/a_b.png).\n";
+        page += "A second line of the same paragraph, ***both*** and _under_.\n\n";
+        page += "- item one with `code`\n- item two with [a link](page.html)\n\n";
+        page += "| Name | Value |\n|:-----|------:|\n| a | **1** |\n| b | *2* |\n\n";
+        page += "```python\ndef f(x):\n    return x * 2  # double\n```\n\n";
+        page += "> quoted text\n\n";
+    }
+    return page;
+}
+
+// Allocations made by a warm parser converting markdown; the first
+// conversions grow the arena and buffers
+size_t convertAllocations(MarkdownParser& parser, const std::string& markdown, std::string& html) {
+    for (int i = 0; i < 2; i++) {
+        html.clear();
+        parser.convertToHTML(markdown, html);
+    }
+    size_t before = allocationCount.load();
+    html.clear();
+    parser.convertToHTML(markdown, html);
+    return allocationCount.load() - before;
+}
+
+} // namespace
+
+int main() {
+    std::string small = generatePage(10);
+    std::string large = generatePage(1000);
+
+    // Splitting lines hands out views into the text
+    {
+        size_t before = allocationCount.load();
+        LineIterator lines(large);
+        std::string_view line;
+        size_t count = 0;
+        while (lines.next(line)) count++;
+        size_t allocations = allocationCount.load() - before;
+        check(allocations == 0 && count > 0, "LineIterator over a 20k-line page", allocations);
+    }
+
+    // Everything per render comes from the arena, which is reused after reset
+    {
+        RenderArena arena;
+        for (int i = 0; i < 2; i++) {
+            arena.reset();
+            std::pmr::string text(large, &arena);
+        }
+        size_t chunks = arena.chunkAllocations();
+        size_t before = allocationCount.load();
+        arena.reset();
+        std::pmr::string text(large, &arena);
+        size_t allocations = allocationCount.load() - before;
+        check(allocations == 0 && arena.chunkAllocations() == chunks, "RenderArena after reset", allocations);
+    }
+
+    MarkdownParser parser;
+    parser.setParallelThreshold(SIZE_MAX);
+    std::string html;
+    html.reserve(large.size() * 4);
+
+    // Rendering a parsed document into a buffer with room to spare
+    {
+        MarkdownDocument doc = parser.parseDocument(large);
+        for (int i = 0; i < 2; i++) {
+            html.clear();
+            parser.renderHTML(doc, html);
+        }
+        size_t before = allocationCount.load();
+        html.clear();
+        parser.renderHTML(doc, html);
+        size_t allocations = allocationCount.load() - before;
+        check(allocations == 0, "renderHTML of a parsed 20k-line page", allocations);
+    }
+
+    // Parsing and rendering a page costs a bounded number of allocations,
+    // the same for 200 lines as for 20k
+    size_t smallAllocations = convertAllocations(parser, small, html);
+    size_t largeAllocations = convertAllocations(parser, large, html);
+    check(smallAllocations <= 16, "convertToHTML of a 200-line page", smallAllocations);
+    check(largeAllocations <= smallAllocations, "convertToHTML of a 20k-line page", largeAllocations);
+
+    // A document kept after the call lives on the heap. Its containers are
+    // sized up front from the line count; only heading anchors add to the
+    // count, at most two allocations each (the 990 extra sections hold 20k
+    // more lines)
+    {
+        size_t before = allocationCount.load();
+        MarkdownDocument smallDoc = parser.parseDocument(small);
+        size_t smallParse = allocationCount.load() - before;
+        check(smallParse <= 64, "parseDocument of a 200-line page", smallParse);
+
+        before = allocationCount.load();
+        MarkdownDocument largeDoc = parser.parseDocument(large);
+        size_t largeParse = allocationCount.load() - before;
+        check(largeParse <= smallParse + 2 * 990, "parseDocument of a 20k-line page", largeParse);
+    }
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
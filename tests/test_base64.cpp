@@ -0,0 +1,242 @@
+// Base64 decoder: RFC 4648 test vectors, padding and alphabet errors, input
+// split across update() calls, and every SIMD decoder the CPU supports
+// checked against the scalar one on random input.
+
+#include "base64.h"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (!ok) {
+        printf("FAIL %s\n", what.c_str());
+        failures++;
+    }
+}
+
+// Printable form of a test input for failure messages
+std::string show(std::string_view text) {
+    std::string shown = "\"";
+    for (unsigned char c : text) {
+        if (c == '\n') {
+            shown += "\\n";
+        } else if (c < 0x20 || c >= 0x7f) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\x%02x", c);
+            shown += escaped;
+        } else {
+            shown += static_cast<char>(c);
+        }
+    }
+    return shown + "\"";
+}
+
+// Reference encoder, with a newline every lineLength characters if set
+std::string encode(std::string_view bytes, size_t lineLength = 0) {
+    static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string encoded;
+    for (size_t i = 0; i < bytes.size(); i += 3) {
+        unsigned int group = static_cast<unsigned char>(bytes[i]) << 16;
+        if (i + 1 < bytes.size()) group |= static_cast<unsigned char>(bytes[i + 1]) << 8;
+        if (i + 2 < bytes.size()) group |= static_cast<unsigned char>(bytes[i + 2]);
+        encoded += ALPHABET[group >> 18];
+        encoded += ALPHABET[(group >> 12) & 63];
+        encoded += i + 1 < bytes.size() ? ALPHABET[(group >> 6) & 63] : '=';
+        encoded += i + 2 < bytes.size() ? ALPHABET[group & 63] : '=';
+    }
+    if (lineLength == 0) return encoded;
+
+    std::string wrapped;
+    for (size_t pos = 0; pos < encoded.size(); pos += lineLength) {
+        wrapped.append(encoded, pos, lineLength);
+        wrapped += '\n';
+    }
+    return wrapped;
+}
+
+std::string randomBytes(std::mt19937& random, size_t length) {
+    std::string bytes(length, '\0');
+    for (char& c : bytes) c = static_cast<char>(random() & 0xff);
+    return bytes;
+}
+
+void testVectors() {
+    // RFC 4648 section 10
+    const std::pair<const char*, const char*> vectors[] = {
+        {"", ""},
+        {"Zg==", "f"},
+        {"Zm8=", "fo"},
+        {"Zm9v", "foo"},
+        {"Zm9vYg==", "foob"},
+        {"Zm9vYmE=", "fooba"},
+        {"Zm9vYmFy", "foobar"},
+        // Missing final padding and whitespace anywhere are accepted
+        {"Zg", "f"},
+        {"Zm9vYmE", "fooba"},
+        {"Zm9v\nYmFy\n", "foobar"},
+        {" Zm 9v\r\nYg=\t=\n", "foob"},
+    };
+    for (const auto& vector : vectors) {
+        std::string out = "prefix:";
+        bool ok = base64Decode(vector.first, out);
+        check(ok && out == std::string("prefix:") + vector.second, "decode " + show(vector.first));
+    }
+}
+
+void testInvalid() {
+    const char* invalid[] = {
+        // Padding
+        "=Zm9v", "Zm=9v", "Zg=", "Z===", "Zg===", "Zm9v=", "Zm9v====", "Zg==Zg==", "Zm9vYg=",
+        // A quantum with one character
+        "Z", "Zm9vY",
+        // Outside the standard alphabet (including the URL-safe one)
+        "Zm9v!", "Zm_v", "Zm-v", "Zm9v\x80", "Zm9v\xff", "Zm.v",
+    };
+    for (const char* input : invalid) {
+        std::string out;
+        check(!base64Decode(input, out), "reject " + show(input));
+    }
+
+    std::string withNul("Zm\0v", 4);
+    std::string out;
+    check(!base64Decode(withNul, out), "reject " + show(withNul));
+
+    // Once invalid, the decoder stays failed
+    Base64Decoder decoder;
+    out.clear();
+    check(!decoder.update("Zm9v!", out), "update after an invalid character");
+    check(!decoder.update("Zm9v", out), "update after a failed update");
+    check(!decoder.finish(out), "finish after a failed update");
+}
+
+// Feeding the input in pieces gives the same bytes as decoding it whole
+bool decodeInPieces(std::string_view input, const std::vector<size_t>& cuts, std::string& out) {
+    Base64Decoder decoder;
+    size_t start = 0;
+    bool ok = true;
+    for (size_t cut : cuts) {
+        ok = decoder.update(input.substr(start, cut - start), out) && ok;
+        start = cut;
+    }
+    ok = decoder.update(input.substr(start), out) && ok;
+    return decoder.finish(out) && ok;
+}
+
+void testChunkBoundaries(std::mt19937& random) {
+    // Every single split point, including inside padding and line breaks
+    for (size_t length : {1, 2, 3, 40, 95}) {
+        std::string bytes = randomBytes(random, length);
+        for (const std::string& encoded : {encode(bytes), encode(bytes, 76), encode(bytes, 7)}) {
+            for (size_t cut = 0; cut <= encoded.size(); cut++) {
+                std::string out;
+                check(decodeInPieces(encoded, {cut}, out) && out == bytes,
+                      "split at " + std::to_string(cut) + " of " + show(encoded));
+            }
+        }
+    }
+
+    // Many random splits of longer payloads, down to one byte per piece
+    for (int round = 0; round < 200; round++) {
+        std::string bytes = randomBytes(random, random() % 3000);
+        std::string encoded = encode(bytes, round % 2 ? 76 : 0);
+        std::vector<size_t> cuts;
+        for (size_t pos = 0; pos < encoded.size(); pos += 1 + random() % (round % 3 ? 64 : 2)) {
+            cuts.push_back(pos);
+        }
+        std::string out;
+        check(decodeInPieces(encoded, cuts, out) && out == bytes,
+              "random split of " + std::to_string(encoded.size()) + " characters");
+    }
+
+    // An error in a later piece is still caught
+    std::string out;
+    check(!decodeInPieces("Zm9vYmFy!m9v", {4, 8}, out), "invalid character after a split");
+    check(!decodeInPieces("Zm9v=Zm9v", {5}, out), "data after padding in the next piece");
+}
+
+struct Result {
+    bool ok;
+    std::string out;
+};
+
+Result decodeWith(const char* implementation, std::string_view input) {
+    selectBase64Implementation(implementation);
+    Result result;
+    result.ok = base64Decode(input, result.out);
+    return result;
+}
+
+// Valid payloads of every length around the SIMD block sizes, with and
+// without line breaks, and the same payloads with one byte broken
+void testImplementations(std::mt19937& random) {
+    std::vector<std::string> inputs;
+    for (size_t length = 0; length < 200; length++) {
+        std::string bytes = randomBytes(random, length);
+        inputs.push_back(encode(bytes));
+        inputs.push_back(encode(bytes, 76));
+    }
+    for (int i = 0; i < 20; i++) {
+        inputs.push_back(encode(randomBytes(random, 1000 + random() % 64000), i % 2 ? 76 : 0));
+    }
+
+    const char BROKEN[] = {'!', '=', '-', '_', ' ', '\n', '\0', '\x80', '\xff', 'A'};
+    size_t count = inputs.size();
+    for (size_t i = 0; i < count; i++) {
+        if (inputs[i].empty()) continue;
+        std::string broken = inputs[i];
+        broken[random() % broken.size()] = BROKEN[random() % sizeof(BROKEN)];
+        inputs.push_back(broken);
+    }
+
+    for (const char* implementation : {"ssse3", "avx2"}) {
+        if (!selectBase64Implementation(implementation)) {
+            printf("skip %s: not supported on this CPU or build\n", implementation);
+            continue;
+        }
+
+        int mismatches = 0;
+        for (const std::string& input : inputs) {
+            Result scalar = decodeWith("scalar", input);
+            Result simd = decodeWith(implementation, input);
+            if (simd.ok != scalar.ok || (scalar.ok && simd.out != scalar.out)) {
+                mismatches++;
+            }
+        }
+        check(mismatches == 0, std::string(implementation) + " differs from scalar on " +
+                                   std::to_string(mismatches) + " of " + std::to_string(inputs.size()) + " inputs");
+        if (mismatches == 0) {
+            printf("ok   %s matches scalar on %zu inputs\n", implementation, inputs.size());
+        }
+    }
+    selectBase64Implementation("scalar");
+}
+
+} // namespace
+
+int main() {
+    std::mt19937 random(4648);
+    const char* startup = base64Implementation();
+
+    // The fixed cases run on each decoder the CPU has
+    for (const char* implementation : {"scalar", "ssse3", "avx2"}) {
+        if (!selectBase64Implementation(implementation)) continue;
+        int before = failures;
+        testVectors();
+        testInvalid();
+        testChunkBoundaries(random);
+        printf("%s %s: vectors, invalid input, chunk boundaries\n", failures == before ? "ok  " : "FAIL",
+               implementation);
+    }
+
+    testImplementations(random);
+    selectBase64Implementation(startup);
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+// Renders every markdown file under content/, and the markdown cells of every
+// notebook, and compares the HTML with tests/golden/ (same relative path,
+// .html). The golden files are the output of the original regex renderer,
+// written by make_golden.sh; output that deliberately changed since is
+// pinned below and applied to them before comparing. Markdown files are also
+// streamed in small windows and must render the same. Run from the
+// repository root.
+
+#include "file_utils.h"
+#include "json.hpp"
+#include "markdown_parser.h"
+#include "toc.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+const fs::path CONTENT_DIR = "content";
+const fs::path GOLDEN_DIR = "tests/golden";
+
+// The table of contents and body of a markdown file, or the HTML of each
+// markdown cell of a notebook (what the markdown renderer makes of it)
+std::string render(const fs::path& source) {
+    std::string content = readFile(source.string());
+    MarkdownParser parser;
+    if (source.extension() != ".ipynb") {
+        MarkdownDocument doc = parser.parseDocument(content);
+        return generateTOC(doc) + parser.renderHTML(doc);
+    }
+
+    std::string html;
+    json notebook = json::parse(content);
+    for (const auto& cell : notebook["cells"]) {
+        if (cell.value("cell_type", "") != "markdown") continue;
+
+        std::string cellSource;
+        const json& lines = cell["source"];
+        if (lines.is_string()) {
+            cellSource = lines.get<std::string>();
+        } else {
+            for (const auto& line : lines) {
+                if (line.is_string()) cellSource += line.get<std::string>();
+            }
+        }
+        parser.convertToHTML(cellSource, html);
+        html += '\n';
+    }
+    return html;
+}
+
+// Buffer size at which streaming a markdown file gives other HTML than
+// rendering it whole, or 0. Small buffers cut nearly every block in pieces.
+size_t streamMismatch(const fs::path& source) {
+    std::string markdown = readFile(source.string());
+    MarkdownParser parser;
+    std::string whole = parser.renderHTML(parser.parseDocument(markdown));
+
+    for (size_t bufferSize : {1, 7, 64, 4096}) {
+        std::istringstream in(markdown);
+        std::ostringstream out;
+        parser.renderStream(in, out, bufferSize);
+        if (out.str() != whole) return bufferSize;
+    }
+    return 0;
+}
+
+// 1-based line where a and b first differ
+size_t firstDifference(const std::string& a, const std::string& b) {
+    auto mismatch = std::mismatch(a.begin(), a.end(), b.begin(), b.end());
+    return std::count(a.begin(), mismatch.first, '\n') + 1;
+}
+
+// Output that deliberately differs from the original renderer: the
+// occurrence-th match of original in the golden file becomes current
+struct Pin {
+    const char* golden;     // Relative to tests/golden
+    int occurrence;         // 1-based
+    const char* original;
+    const char* current;
+};
+
+const Pin PINNED[] = {
+    // Underscores inside words are not emphasis, in URLs and code spans alike
+    {"blog/tech/AI/fastai_ch1.html", 1, "dlcf<em>0106</em>1766443982396_0.png", "dlcf_0106_1766443982396_0.png"},
+    {"blog/02_production.html", 1, "<code>search<em>images</em>bing</code>", "<code>search_images_bing</code>"},
+    {"blog/02_production.html", 1, "<code>get<em>image</em>files</code>", "<code>get_image_files</code>"},
+    {"blog/02_production.html", 1, "<code>aug<em>transforms</code>", "<code>aug_transforms</code>"},
+    {"blog/02_production.html", 1, "<code>batch</em>tfms</code> parameter", "<code>batch_tfms</code> parameter"},
+    {"blog/02_production.html", 1, "<code>plot<em>top</em>losses</code>", "<code>plot_top_losses</code>"},
+    {"blog/02_production.html", 1, "<code>item<em>tfms</code> and <code>batch</em>tfms</code>",
+     "<code>item_tfms</code> and <code>batch_tfms</code>"},
+
+    // Headings that repeat get a -1 suffix, in the heading and in the TOC
+    {"blog/tech/shortest_path_algorithms.html", 2, "\"#first-iteration\"", "\"#first-iteration-1\""},
+    {"blog/tech/shortest_path_algorithms.html", 2, "\"#edge-ab-weight-5\"", "\"#edge-ab-weight-5-1\""},
+    {"blog/tech/shortest_path_algorithms.html", 2, "\"#edge-bc-weight--5\"", "\"#edge-bc-weight--5-1\""},
+    {"blog/tech/shortest_path_algorithms.html", 2, "\"#edge-cd-weight-3\"", "\"#edge-cd-weight-3-1\""},
+    {"blog/tech/shortest_path_algorithms.html", 2, "\"#edge-ce-weight-1\"", "\"#edge-ce-weight-1-1\""},
+    {"blog/tech/shortest_path_algorithms.html", 2, "\"#edge-de-weight-2\"", "\"#edge-de-weight-2-1\""},
+    {"blog/tech/shortest_path_algorithms.html", 2, "\"#second-iteration\"", "\"#second-iteration-1\""},
+    {"blog/tech/shortest_path_algorithms.html", 2, "id=\"first-iteration\"", "id=\"first-iteration-1\""},
+    {"blog/tech/shortest_path_algorithms.html", 2, "id=\"second-iteration\"", "id=\"second-iteration-1\""},
+    {"blog/tech/shortest_path_algorithms.html", 2, "id=\"edge-ab-weight-5\"", "id=\"edge-ab-weight-5-1\""},
+    {"blog/tech/shortest_path_algorithms.html", 2, "id=\"edge-bc-weight--5\"", "id=\"edge-bc-weight--5-1\""},
+    {"blog/tech/shortest_path_algorithms.html", 2, "id=\"edge-cd-weight-3\"", "id=\"edge-cd-weight-3-1\""},
+    {"blog/tech/shortest_path_algorithms.html", 2, "id=\"edge-ce-weight-1\"", "id=\"edge-ce-weight-1-1\""},
+    {"blog/tech/shortest_path_algorithms.html", 2, "id=\"edge-de-weight-2\"", "id=\"edge-de-weight-2-1\""},
+};
+
+// Code blocks are now highlighted when the site is built and name their
+// language in a class; the original renderer left both to Prism.js. The
+// token spans and the class are taken out, leaving the escaped code the
+// original wrote.
+std::string withoutHighlighting(const std::string& html) {
+    const std::string_view OPEN = "<pre><code";
+    const std::string_view CLOSE = "</code></pre>";
+    std::string plain;
+    size_t pos = 0;
+    size_t block;
+    while ((block = html.find(OPEN, pos)) != std::string::npos) {
+        size_t body = html.find('>', block) + 1;
+        size_t end = html.find(CLOSE, body);
+        if (end == std::string::npos) end = html.size();
+        plain.append(html, pos, block - pos);
+        plain += "<pre><code>";
+
+        // Drop every tag inside the block; the code itself is escaped
+        for (size_t i = body; i < end; i++) {
+            if (html[i] == '<') {
+                i = html.find('>', i);
+            } else {
+                plain += html[i];
+            }
+        }
+        pos = end;
+    }
+    plain.append(html, pos, std::string::npos);
+    return plain;
+}
+
+// Apply the pins for golden to its text; false if one no longer matches, so
+// a stale pin is reported instead of silently doing nothing
+bool applyPins(const std::string& golden, std::string& html) {
+    bool ok = true;
+    for (const Pin& pin : PINNED) {
+        if (golden != pin.golden) continue;
+
+        size_t pos = std::string::npos;
+        for (int i = 0; i < pin.occurrence; i++) {
+            pos = html.find(pin.original, pos == std::string::npos ? 0 : pos + 1);
+            if (pos == std::string::npos) break;
+        }
+        if (pos == std::string::npos) {
+            printf("FAIL %s: pinned text %s not found\n", pin.golden, pin.original);
+            ok = false;
+            continue;
+        }
+        html.replace(pos, std::string_view(pin.original).size(), pin.current);
+    }
+    return ok;
+}
+
+} // namespace
+
+int main() {
+    if (!fs::is_directory(CONTENT_DIR)) {
+        fprintf(stderr, "test_golden: run from the repository root (no %s/ here)\n", CONTENT_DIR.c_str());
+        return 2;
+    }
+
+    std::vector<fs::path> sources;
+    for (const auto& entry : fs::recursive_directory_iterator(CONTENT_DIR)) {
+        std::string extension = entry.path().extension().string();
+        if (entry.is_regular_file() && (extension == ".md" || extension == ".ipynb")) {
+            sources.push_back(entry.path());
+        }
+    }
+    std::sort(sources.begin(), sources.end());
+
+    int failures = 0;
+    for (const auto& source : sources) {
+        fs::path relative = fs::relative(source, CONTENT_DIR);
+        relative.replace_extension(".html");
+        fs::path golden = GOLDEN_DIR / relative;
+
+        if (!fs::exists(golden)) {
+            printf("FAIL %s: no golden file %s\n", source.generic_string().c_str(), golden.generic_string().c_str());
+            failures++;
+            continue;
+        }
+
+        std::string html = withoutHighlighting(render(source));
+        std::string expected = readFile(golden.string());
+        if (!applyPins(relative.generic_string(), expected)) {
+            failures++;
+        } else if (html != expected) {
+            printf("FAIL %s: differs from %s at line %zu\n", source.generic_string().c_str(),
+                   golden.generic_string().c_str(), firstDifference(html, expected));
+            failures++;
+        } else if (size_t bufferSize = source.extension() == ".md" ? streamMismatch(source) : 0) {
+            printf("FAIL %s: streamed with a %zu-byte buffer differs\n", source.generic_string().c_str(),
+                   bufferSize);
+            failures++;
+        } else {
+            printf("ok   %s\n", source.generic_string().c_str());
+        }
+    }
+
+    // A pin whose file is gone would never be checked
+    for (const Pin& pin : PINNED) {
+        if (!fs::exists(GOLDEN_DIR / pin.golden)) {
+            printf("FAIL %s: pinned file not found\n", pin.golden);
+            failures++;
+        }
+    }
+
+    printf("%zu files, %d failures\n", sources.size(), failures);
+    return failures == 0 ? 0 : 1;
+}